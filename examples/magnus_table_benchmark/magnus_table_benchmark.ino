@@ -0,0 +1,66 @@
+/**
+ * @file  magnus_table_benchmark.ino
+ * @brief Compares the Magnus lookup table against the libm exp() path on the target board (e.g. Cortex-M or ESP32) for speed and accuracy.
+ *        No sensor is required. Results are printed to the serial monitor. Enable the table in the library with SE_BME680_ENABLE_MAGNUS_TABLE.
+ */
+
+#include <MagnusTable.h>
+
+const int iterations = 5000; // Number of evaluations per pass, spread across the full table range
+
+volatile float sink = 0.0F; // Keeps the compiler from optimizing the loops away
+
+// Time one pass of a saturation vapor pressure function, in microseconds per call
+float timePass(float (*svp)(float))
+{
+  unsigned long start = micros();
+  for (int i = 0; i < iterations; i++)
+  {
+    sink += svp(-40.0F + 125.0F * (float)i / (float)iterations);
+  }
+  return (float)(micros() - start) / (float)iterations;
+}
+
+void setup()
+{
+  // Serial initialization
+  Serial.begin(115200);
+  while (!Serial) { delay(10); }
+}
+
+void loop()
+{
+  // Worst relative error of the table against the libm path across the table range
+  float maxError = 0.0F, maxErrorAt = 0.0F;
+  for (int i = 0; i < iterations; i++)
+  {
+    float t = -40.0F + 125.0F * (float)i / (float)iterations;
+    float exact = magnusSaturationVaporPressureExact(t);
+    float error = fabs(magnusSaturationVaporPressureTable(t) - exact) / exact;
+    if (error > maxError)
+    {
+      maxError = error;
+      maxErrorAt = t;
+    }
+  }
+
+  float tableTime = timePass(magnusSaturationVaporPressureTable);
+  float exactTime = timePass(magnusSaturationVaporPressureExact);
+
+  Serial.print("Table entries:         ");
+  Serial.println(MAGNUS_TABLE_SIZE);
+  Serial.print("Table flash (bytes):   ");
+  Serial.println(MAGNUS_TABLE_SIZE * (int)sizeof(float));
+  Serial.print("libm exp() (us/call):  ");
+  Serial.println(exactTime, 3);
+  Serial.print("Table (us/call):       ");
+  Serial.println(tableTime, 3);
+  Serial.print("Max error (ppm):       ");
+  Serial.print(maxError * 1e6F, 2);
+  Serial.print(" at ");
+  Serial.print(maxErrorAt, 2);
+  Serial.println(" °C");
+  Serial.println();
+
+  delay(5000);
+}
@@ -0,0 +1,286 @@
+/**
+ * @file  engine_benchmark.cpp
+ * @brief Host-side ingestion benchmark for IAQEngine. Simulates a gateway receiving readings from N devices with synthetic streams, runs the full
+ *        pipeline (temperature and humidity compensation, dew point, Donchian smoothing, gas calibration and IAQ) and reports, for each device count
+ *        and number of worker threads:
+ *          samples/s   Throughput with the producers submitting as fast as the queues accept readings
+ *          p50, p99    Latency from submit() to the result callback for every 8th reading, at a fixed fraction of that throughput (at saturation,
+ *                      latency only measures how full the queues are)
+ *          pool B/dev  Memory of the device pools (core, smoothing history, hot record and index) per device
+ *          rss B/dev   Growth of the resident set size per device, including the ingestion queues (first run of each device count only, since
+ *                      later runs reuse memory freed by the previous engine)
+ *
+ *        Build:  g++ -O2 -pthread -I../../src -I../gateway engine_benchmark.cpp -o engine_benchmark
+ *        Usage:  ./engine_benchmark [-d 100,1000,10000,100000] [-t 1,2,4,8] [-r readings] [-w readings] [-s periods] [-l load] [-p producers]
+ *
+ *          -d  Device counts (default 100, 1000, 10000 and 100000)
+ *          -t  Worker thread counts (default 1, 2, 4, ... up to the number of hardware threads)
+ *          -r  Timed readings per device (default: one million readings per run, and at least 20 per device)
+ *          -w  Untimed warm-up readings per device (default: enough to fill the smoothing window and reach normal calibration)
+ *          -s  Donchian smoothing periods, or 0 for no smoothing (default 200)
+ *          -l  Load for the latency measurement, as a fraction of the measured throughput (default 0.5)
+ *          -p  Producer threads, each submitting the readings of its own devices in order (default 1)
+ *
+ *        Devices report every 3 seconds of simulated time, and each run goes through three phases on one engine: warm-up, throughput, and about
+ *        5 seconds at the latency load. Calibration timings are set to their minimums and the warm-up fills the smoothing windows, so the timed
+ *        phases measure the steady state of a long-running gateway rather than its start-up. Runs with 100,000 devices take minutes.
+ */
+
+#include <IAQEngine.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+static const unsigned long interval = 3000; // Simulated reading interval in milliseconds
+static const int latencyStride = 8; // Latency is recorded for every latencyStride-th reading
+
+// Nanoseconds since an arbitrary start
+static uint64_t nanoseconds(void)
+{
+  return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Resident set size in bytes, or zero where /proc is not available
+static size_t residentBytes(void)
+{
+  FILE* f = fopen("/proc/self/statm", "r");
+  if (f == nullptr) return 0;
+  unsigned long size = 0, resident = 0;
+  int n = fscanf(f, "%lu %lu", &size, &resident);
+  fclose(f);
+  return n == 2 ? (size_t)resident * (size_t)sysconf(_SC_PAGESIZE) : 0;
+}
+
+// Parse a comma-separated list of positive integers
+static std::vector<int> parseList(const char* text)
+{
+  std::vector<int> values;
+  for (const char* p = text; *p;)
+  {
+    int v = atoi(p);
+    if (v > 0) values.push_back(v);
+    while (*p && *p != ',') p++;
+    if (*p == ',') p++;
+  }
+  return values;
+}
+
+// Synthetic stream of one device: a daily cycle, a 20 minute HVAC cycle, noise, and occasional gas readings above the calibration limit
+struct Stream
+{
+  float temperature; // Mean raw temperature
+  float humidity; // Mean raw humidity
+  float gas; // Mean raw gas resistance
+  float cos_phase, sin_phase; // Phase of the cycles
+  uint32_t seed;
+};
+
+// Cycle values shared by all devices in one tick, so a reading costs a few multiplications instead of sinf() calls
+struct Tick
+{
+  float day_sin, day_cos, hvac_sin, hvac_cos;
+
+  explicit Tick(long k)
+  {
+    float day = 6.2831853F * (float)(k % 28800) / 28800.0F; // 28800 readings per day
+    float hvac = 6.2831853F * (float)(k % 400) / 400.0F;
+    day_sin = sinf(day);
+    day_cos = cosf(day);
+    hvac_sin = sinf(hvac);
+    hvac_cos = cosf(hvac);
+  }
+};
+
+// Reading k of a device
+static IAQSample reading(const Stream& stream, uint32_t device, long k, const Tick& tick)
+{
+  uint32_t x = stream.seed ^ ((uint32_t)k * 2246822519u); // Noise hash of device and tick
+  x ^= x >> 15;
+  x *= 2654435761u;
+  x ^= x >> 13;
+  float noise = (float)(x % 1000) / 1000.0F - 0.5F;
+  float day = tick.day_sin * stream.cos_phase + tick.day_cos * stream.sin_phase;
+  float hvac = tick.hvac_sin * stream.cos_phase + tick.hvac_cos * stream.sin_phase;
+  IAQSample s;
+  s.device = device;
+  s.timestamp = (unsigned long)k * interval;
+  s.temperature = stream.temperature + 2.0F * day + 0.8F * hvac + 0.2F * noise;
+  s.humidity = stream.humidity + 6.0F * day + 3.0F * hvac + 0.5F * noise;
+  s.pressure = 101325.0F + 300.0F * day;
+  s.gas_resistance = (x % 500 == 0) ? 300000 : (uint32_t)(stream.gas * (1.0F - 0.15F * day + 0.05F * noise));
+  return s;
+}
+
+// Results of one benchmark run
+struct Run
+{
+  double throughput = 0; // Readings per second
+  double p50 = 0, p99 = 0; // Latency in microseconds
+  size_t pool_bytes = 0; // Device pool memory
+  size_t resident_bytes = 0; // Resident set growth from creating the engine to the end of the warm-up
+};
+
+// One engine with a fixed number of devices and threads
+class Benchmark
+{
+  private:
+    std::vector<Stream> streams;
+    int devices, threads, producers, periods;
+    std::vector<uint64_t> submitted; // Submit times of the recorded readings of the latency phase
+    std::vector<uint32_t> latencies; // Latencies of the recorded readings in nanoseconds
+    long latency_first = 0; // First tick of the latency phase, the only phase whose readings are recorded
+
+    // Submit ticks [first, last) from all producers, each reading at its scheduled time if a rate is given, and wait until all are processed
+    void submit(IAQEngine& engine, long first, long last, double rate)
+    {
+      uint64_t start = nanoseconds();
+      std::vector<std::thread> producerThreads;
+      for (int p = 0; p < producers; p++)
+      {
+        producerThreads.emplace_back([&, p]()
+        {
+          for (long k = first; k < last; k++)
+          {
+            Tick tick(k);
+            for (int d = p; d < devices; d += producers)
+            {
+              size_t index = (size_t)(k - first) * devices + d;
+              if (rate > 0)
+              {
+                uint64_t due = start + (uint64_t)((double)index * 1e9 / rate);
+                while (nanoseconds() < due) std::this_thread::yield();
+              }
+              IAQSample s = reading(streams[d], (uint32_t)d, k, tick);
+              if (rate > 0 && index % latencyStride == 0) submitted[index / latencyStride] = nanoseconds(); // Read by a worker after it takes the reading from the queue
+              while (!engine.submit(s)) std::this_thread::yield(); // Queue full, wait for the workers
+            }
+          }
+        });
+      }
+      for (size_t p = 0; p < producerThreads.size(); p++) producerThreads[p].join();
+      engine.flush();
+    }
+
+  public:
+    Benchmark(int devices, int threads, int producers, int periods) : devices(devices), threads(threads), producers(producers), periods(periods)
+    {
+      streams.resize(devices);
+      for (int d = 0; d < devices; d++)
+      {
+        uint32_t x = (uint32_t)d * 2654435761u + 12345u;
+        float phase = (float)(x % 6283) / 1000.0F;
+        streams[d].temperature = 19.0F + (float)(x % 800) / 100.0F;
+        streams[d].humidity = 30.0F + (float)((x >> 10) % 3000) / 100.0F;
+        streams[d].gas = 80000.0F + (float)((x >> 4) % 100000);
+        streams[d].cos_phase = cosf(phase);
+        streams[d].sin_phase = sinf(phase);
+        streams[d].seed = x;
+      }
+    }
+
+    // Warm up, measure the throughput at saturation, then the latency at a fraction of that throughput
+    Run run(long warmup, long timed, double load)
+    {
+      Run result;
+      size_t residentBefore = residentBytes();
+      IAQEngine engine(threads);
+      if (periods > 0) engine.setSmoothingPool(3 * periods);
+      engine.onConfigure([this](uint32_t, IAQCore& core)
+      {
+        core.setGasCalibrationTimings(1000, 2000, 62000);
+        if (periods > 0) core.setDonchianSmoothing(true, periods);
+      });
+      engine.onResult([this](const IAQSample& sample, IAQCore&)
+      {
+        long k = (long)(sample.timestamp / interval);
+        if (k < latency_first) return;
+        size_t index = (size_t)(k - latency_first) * devices + sample.device;
+        if (index % latencyStride == 0) latencies[index / latencyStride] = (uint32_t)std::min<uint64_t>(nanoseconds() - submitted[index / latencyStride], 0xFFFFFFFFu);
+      });
+
+      // Warm-up and throughput, with nothing recorded
+      latency_first = warmup + timed;
+      submit(engine, 0, warmup, 0);
+      size_t residentAfter = residentBytes();
+      result.resident_bytes = residentAfter > residentBefore ? residentAfter - residentBefore : 0;
+      uint64_t start = nanoseconds();
+      submit(engine, warmup, warmup + timed, 0);
+      result.throughput = (double)timed * devices / ((double)(nanoseconds() - start) / 1e9);
+      result.pool_bytes = engine.getDeviceMemory();
+
+      // Latency over about 5 seconds at the given load
+      double rate = result.throughput * load;
+      long ticks = (long)(rate * 5.0 / devices) + 1;
+      size_t recorded = ((size_t)ticks * devices + latencyStride - 1) / latencyStride;
+      submitted.assign(recorded, 0);
+      latencies.assign(recorded, 0);
+      submit(engine, latency_first, latency_first + ticks, rate);
+      std::sort(latencies.begin(), latencies.end());
+      result.p50 = latencies[latencies.size() / 2] / 1000.0;
+      result.p99 = latencies[std::min(latencies.size() - 1, latencies.size() * 99 / 100)] / 1000.0;
+      return result;
+    }
+};
+
+int main(int argc, char** argv)
+{
+  std::vector<int> deviceCounts = { 100, 1000, 10000, 100000 };
+  std::vector<int> threadCounts;
+  long timedReadings = 0, warmupReadings = -1;
+  int periods = 200, producers = 1;
+  double load = 0.5;
+  for (int i = 1; i + 1 < argc; i += 2)
+  {
+    if (!strcmp(argv[i], "-d")) deviceCounts = parseList(argv[i + 1]);
+    else if (!strcmp(argv[i], "-t")) threadCounts = parseList(argv[i + 1]);
+    else if (!strcmp(argv[i], "-r")) timedReadings = atol(argv[i + 1]);
+    else if (!strcmp(argv[i], "-w")) warmupReadings = atol(argv[i + 1]);
+    else if (!strcmp(argv[i], "-s")) periods = atoi(argv[i + 1]);
+    else if (!strcmp(argv[i], "-l")) load = atof(argv[i + 1]);
+    else if (!strcmp(argv[i], "-p")) producers = atoi(argv[i + 1]);
+    else
+    {
+      fprintf(stderr, "Unknown option %s\n", argv[i]);
+      return 1;
+    }
+  }
+  int hardwareThreads = (int)std::thread::hardware_concurrency();
+  if (hardwareThreads <= 0) hardwareThreads = 1;
+  if (threadCounts.empty())
+  {
+    for (int t = 1; t < hardwareThreads; t *= 2) threadCounts.push_back(t);
+    threadCounts.push_back(hardwareThreads);
+  }
+  if (producers < 1) producers = 1;
+  if (periods < 2) periods = 0;
+  if (!(load > 0.0 && load <= 1.0)) load = 0.5;
+  if (warmupReadings < 0) warmupReadings = std::max(periods, GAS_CALIBRATION_DATA_POINTS + 20); // Full smoothing window and calibration data
+
+  printf("Hardware threads %d, producers %d, Donchian periods %d, warm-up %ld readings per device, latency at %.0f%% of throughput\n",
+         hardwareThreads, producers, periods, warmupReadings, load * 100.0);
+  printf("%8s %7s %10s %12s %8s %9s %9s %10s %10s\n", "devices", "threads", "readings", "samples/s", "scaling", "p50 us", "p99 us", "pool B/dev", "rss B/dev");
+  for (size_t di = 0; di < deviceCounts.size(); di++)
+  {
+    int devices = deviceCounts[di];
+    long timed = timedReadings > 0 ? timedReadings : std::max(20L, 1000000L / devices);
+    double baseline = 0;
+    for (size_t ti = 0; ti < threadCounts.size(); ti++)
+    {
+      Benchmark benchmark(devices, threadCounts[ti], producers, periods);
+      Run run = benchmark.run(warmupReadings, timed, load);
+      if (ti == 0) baseline = run.throughput;
+      char resident[16] = "-";
+      if (ti == 0) snprintf(resident, sizeof(resident), "%zu", run.resident_bytes / devices);
+      printf("%8d %7d %10ld %12.0f %7.2fx %9.1f %9.1f %10zu %10s\n", devices, threadCounts[ti], timed * devices, run.throughput, run.throughput / baseline,
+             run.p50, run.p99, run.pool_bytes / devices, resident);
+      fflush(stdout);
+    }
+  }
+  return 0;
+}
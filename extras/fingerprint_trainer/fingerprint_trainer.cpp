@@ -0,0 +1,179 @@
+/**
+ * @file  fingerprint_trainer.cpp
+ * @brief Host-side trainer for GasFingerprint. Reads recorded heater scans and writes a header with the normalized class centroids for the sensor.
+ *
+ *        Build:  g++ -O2 -I../../src fingerprint_trainer.cpp -o fingerprint_trainer
+ *        Usage:  ./fingerprint_trainer scans.csv > fingerprints.h
+ *
+ *        Input is CSV with one scan per line: a class label followed by the gas resistance in ohms at each heater step, for example
+ *          clean_air,182000,95400,41200,20100
+ *          ethanol,61000,20500,7900,3600
+ *        Lines starting with # and blank lines are ignored. Every scan must have the same number of steps, in the same heater order used on the sensor.
+ *        Labels are written into the header as C strings, so they must not be empty or contain quotes, backslashes or control characters.
+ *        Training accuracy (leave-one-out) is reported on stderr. Scans of classes with a single scan cannot be tested that way and are left out of it.
+ */
+
+#include <GasFingerprint.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+
+struct Scan
+{
+  int label; // Index into the class names
+  std::vector<float> normalized; // Normalized log-resistance vector
+};
+
+// Average the normalized scans of each class and renormalize to unit length, optionally leaving one scan out. A class without scans gets an empty centroid.
+static std::vector<std::vector<float>> trainCentroids(const std::vector<Scan>& scans, int classes, int steps, int leaveOut)
+{
+  std::vector<std::vector<float>> centroids(classes, std::vector<float>(steps, 0.0F));
+  for (size_t s = 0; s < scans.size(); s++)
+  {
+    if ((int)s == leaveOut) continue;
+    for (int i = 0; i < steps; i++) centroids[scans[s].label][i] += scans[s].normalized[i];
+  }
+  for (int k = 0; k < classes; k++)
+  {
+    double norm = 0.0;
+    for (int i = 0; i < steps; i++) norm += (double)centroids[k][i] * centroids[k][i];
+    if (norm <= 0.0)
+    {
+      centroids[k].clear(); // No scans for this class
+      continue;
+    }
+    for (int i = 0; i < steps; i++) centroids[k][i] = (float)(centroids[k][i] / sqrt(norm));
+  }
+  return centroids;
+}
+
+// Classify a normalized scan against centroids using the same distance as GasFingerprint::classify(), ignoring classes without scans
+static int nearest(const std::vector<std::vector<float>>& centroids, const std::vector<float>& v)
+{
+  int best = -1;
+  float bestDistance = 1e30F;
+  for (size_t k = 0; k < centroids.size(); k++)
+  {
+    if (centroids[k].empty()) continue;
+    float d = 0.0F;
+    for (size_t i = 0; i < v.size(); i++) d += (v[i] - centroids[k][i]) * (v[i] - centroids[k][i]);
+    if (d < bestDistance)
+    {
+      bestDistance = d;
+      best = (int)k;
+    }
+  }
+  return best;
+}
+
+int main(int argc, char** argv)
+{
+  if (argc < 2)
+  {
+    fprintf(stderr, "Usage: %s scans.csv > fingerprints.h\n", argv[0]);
+    return 1;
+  }
+  std::ifstream input(argv[1]);
+  if (!input)
+  {
+    fprintf(stderr, "ERROR: Could not open %s\n", argv[1]);
+    return 1;
+  }
+
+  // Parse and normalize the scans
+  std::vector<std::string> names;
+  std::vector<Scan> scans;
+  int steps = 0, lineNumber = 0;
+  std::string line;
+  while (std::getline(input, line))
+  {
+    lineNumber++;
+    if (line.empty() || line[0] == '#' || line.find_first_not_of(" \t\r") == std::string::npos) continue;
+    std::stringstream fields(line);
+    std::string label, field;
+    std::getline(fields, label, ',');
+    bool printable = !label.empty();
+    for (size_t i = 0; i < label.size(); i++) if (label[i] == '"' || label[i] == '\\' || (unsigned char)label[i] < 0x20 || label[i] == 0x7F) printable = false;
+    if (!printable)
+    {
+      fprintf(stderr, "ERROR: Line %d has an empty label or a label with quotes, backslashes or control characters\n", lineNumber);
+      return 1;
+    }
+    std::vector<float> resistances;
+    while (std::getline(fields, field, ',')) resistances.push_back(strtof(field.c_str(), nullptr));
+    if (steps == 0) steps = (int)resistances.size();
+    if ((int)resistances.size() != steps || steps > GAS_FINGERPRINT_STEPS_MAX)
+    {
+      fprintf(stderr, "ERROR: Line %d has %d steps, expected %d (at most %d)\n", lineNumber, (int)resistances.size(), steps, GAS_FINGERPRINT_STEPS_MAX);
+      return 1;
+    }
+    Scan scan;
+    scan.normalized.resize(steps);
+    if (!GasFingerprint::normalize(resistances.data(), steps, scan.normalized.data()))
+    {
+      fprintf(stderr, "WARNING: Skipping line %d, invalid or flat scan\n", lineNumber);
+      continue;
+    }
+    scan.label = -1;
+    for (size_t k = 0; k < names.size(); k++) if (names[k] == label) scan.label = (int)k;
+    if (scan.label < 0)
+    {
+      scan.label = (int)names.size();
+      names.push_back(label);
+    }
+    scans.push_back(scan);
+  }
+  if (scans.empty())
+  {
+    fprintf(stderr, "ERROR: No valid scans\n");
+    return 1;
+  }
+  int classes = (int)names.size();
+
+  // Leave-one-out accuracy estimate. A scan that is the only one of its class has nothing left to train its class, so it is not tested.
+  std::vector<int> classScans(classes, 0);
+  for (size_t s = 0; s < scans.size(); s++) classScans[scans[s].label]++;
+  int correct = 0, tested = 0;
+  for (size_t s = 0; s < scans.size(); s++)
+  {
+    if (classScans[scans[s].label] < 2) continue;
+    tested++;
+    if (nearest(trainCentroids(scans, classes, steps, (int)s), scans[s].normalized) == scans[s].label) correct++;
+  }
+  if (tested > 0)
+  {
+    fprintf(stderr, "%d scans, %d classes, %d steps, leave-one-out accuracy %.1f%% (%d scans tested)\n", (int)scans.size(), classes, steps, 100.0 * correct / tested, tested);
+  }
+  else
+  {
+    fprintf(stderr, "%d scans, %d classes, %d steps, leave-one-out accuracy not available\n", (int)scans.size(), classes, steps);
+  }
+  for (int k = 0; k < classes; k++)
+  {
+    if (classScans[k] < 2) fprintf(stderr, "WARNING: Class %s has a single scan and was not tested, record more scans of it\n", names[k].c_str());
+  }
+
+  // Write the header
+  std::vector<std::vector<float>> centroids = trainCentroids(scans, classes, steps, -1);
+  printf("// Generated by fingerprint_trainer from %s (%d scans)\n", argv[1], (int)scans.size());
+  printf("#include <GasFingerprint.h>\n\n");
+  printf("#define GAS_FINGERPRINT_CLASSES %d\n", classes);
+  printf("#define GAS_FINGERPRINT_STEPS %d\n\n", steps);
+  printf("const char* const gas_fingerprint_labels[GAS_FINGERPRINT_CLASSES] = {");
+  for (int k = 0; k < classes; k++) printf("%s\"%s\"", k ? ", " : " ", names[k].c_str());
+  printf(" };\n\n");
+  printf("const float gas_fingerprint_centroids[GAS_FINGERPRINT_CLASSES * GAS_FINGERPRINT_STEPS] PROGMEM =\n{\n");
+  for (int k = 0; k < classes; k++)
+  {
+    printf("  ");
+    for (int i = 0; i < steps; i++) printf("%s%.7fF", i ? ", " : "", centroids[k][i]);
+    printf("%s // %s\n", k == classes - 1 ? "" : ",", names[k].c_str());
+  }
+  printf("};\n");
+  return 0;
+}
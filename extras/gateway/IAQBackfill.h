@@ -0,0 +1,224 @@
+/**
+ * @file  IAQBackfill.h
+ * @brief Historical backfill: recompute IAQ over recorded sensor histories, with periodic checkpoints of the complete pipeline state.
+ *        Each sample depends on the calibration state before it, so one device's history is processed sequentially. Devices are independent and run
+ *        in parallel. Checkpoints are copies of the IAQ core (configuration, calibration array, stage, timers, filters and smoothing history) taken every
+ *        few samples. A re-run starts from the last checkpoint before a given time, optionally with changed settings, instead of replaying the history
+ *        from its start. Many re-runs, for any devices and starting points, also run in parallel.
+ *
+ *        Host only (uses the C++11 standard library and threads). Include with -I pointing at the library's src directory, and link with -pthread.
+ */
+
+#ifndef __IAQ_BACKFILL_H__
+#define __IAQ_BACKFILL_H__
+
+#include <IAQCore.h>
+#include "IAQEngine.h"
+#include <stdint.h>
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/*!
+*  @brief  Re-run of one device's history from a checkpoint
+*/
+template <class Core = IAQCore>
+struct IAQBackfillRerunT
+{
+  uint32_t device; // Device id
+  unsigned long from; // Start time: the re-run starts at the last checkpoint at or before this timestamp
+  std::function<void(Core& core)> reconfigure; // Optional, applied to the checkpoint copy before the re-run, e.g. to change the slope factor
+};
+
+/*!
+*  @brief  Backfill of recorded histories for many devices, with checkpoints for re-runs
+*  @tparam Core
+*          Per-device IAQ state, IAQCore or an IAQCoreT with a custom policy
+*/
+template <class Core = IAQCore>
+class IAQBackfillT
+{
+  public:
+    typedef IAQBackfillRerunT<Core> Rerun;
+    typedef std::function<void(uint32_t device, Core& core)> ConfigureCallback; // Configures the core of a device before its history is processed
+    typedef std::function<void(size_t index, const IAQSample& sample, Core& core)> ResultCallback; // Receives each processed sample and its index in the device's history
+    typedef std::function<void(size_t rerun, size_t index, const IAQSample& sample, Core& core)> RerunResultCallback; // Same, with the index of the re-run
+
+  private:
+    // One checkpoint: the state of the core before the sample at the given index
+    struct Checkpoint
+    {
+      size_t index;
+      std::unique_ptr<Core> core;
+    };
+
+    // One device's history and checkpoints
+    struct Device
+    {
+      uint32_t id;
+      const IAQSample* samples; // Owned by the caller, in timestamp order
+      size_t count;
+      std::vector<Checkpoint> checkpoints; // In sample order, starting with the configured core before the first sample
+    };
+
+    std::vector<Device> devices;
+    std::unordered_map<uint32_t, size_t> device_index; // Device id to index into devices
+    size_t checkpoint_interval; // Samples between checkpoints
+
+    // Last checkpoint at or before a timestamp, or the first checkpoint if the timestamp precedes the history
+    static const Checkpoint* findCheckpoint(const Device& device, unsigned long from)
+    {
+      if (device.checkpoints.empty()) return nullptr;
+      typename std::vector<Checkpoint>::const_iterator it = std::upper_bound(device.checkpoints.begin(), device.checkpoints.end(), from,
+        [&device](unsigned long t, const Checkpoint& c) { return t < device.samples[c.index].timestamp; });
+      return it == device.checkpoints.begin() ? &*it : &*(it - 1);
+    }
+
+    // Run a job for each index on a number of threads, each taking the next index when it is done
+    static void parallelFor(size_t count, int threads, const std::function<void(size_t)>& job)
+    {
+      if (threads <= 0) threads = (int)std::thread::hardware_concurrency();
+      if (threads <= 0) threads = 1;
+      if ((size_t)threads > count) threads = (int)count;
+      std::atomic<size_t> next(0);
+      std::vector<std::thread> workers;
+      for (int t = 0; t < threads; t++)
+      {
+        workers.emplace_back([&]()
+        {
+          for (size_t i = next++; i < count; i = next++) job(i);
+        });
+      }
+      for (size_t t = 0; t < workers.size(); t++) workers[t].join();
+    }
+
+    // Process one device's full history, taking checkpoints along the way
+    void runDevice(Device& device, const ConfigureCallback& configure, const ResultCallback& result)
+    {
+      device.checkpoints.clear();
+      if (device.count == 0) return;
+      Core core;
+      core.resetCalibration(device.samples[0].timestamp); // Calibration timing starts with the first sample, as in IAQEngine
+      if (configure) configure(device.id, core);
+      for (size_t i = 0; i < device.count; i++)
+      {
+        if (i % checkpoint_interval == 0)
+        {
+          Checkpoint checkpoint;
+          checkpoint.index = i;
+          checkpoint.core.reset(new Core(core));
+          device.checkpoints.push_back(std::move(checkpoint));
+        }
+        const IAQSample& sample = device.samples[i];
+        core.process(sample.timestamp, sample.temperature, sample.humidity, sample.pressure, sample.gas_resistance);
+        if (result) result(i, sample, core);
+      }
+    }
+
+  public:
+    /*!
+    *  @brief  Constructor
+    *  @param  checkpointInterval
+    *          Number of samples between checkpoints. Each checkpoint holds a copy of the core including its smoothing history.
+    */
+    explicit IAQBackfillT(size_t checkpointInterval = 10000) : checkpoint_interval(checkpointInterval > 0 ? checkpointInterval : 1) {}
+
+    /*!
+    *  @brief  Add a device's recorded history. Histories must stay valid while the backfill is in use.
+    *  @param  device
+    *          Device id
+    *  @param  samples
+    *          Samples of the device in timestamp order, e.g. after an IAQReorderBuffer
+    *  @param  count
+    *          Number of samples
+    *  @return True if the device was added, false if it was already added
+    */
+    bool addDevice(uint32_t device, const IAQSample* samples, size_t count)
+    {
+      if (device_index.count(device)) return false;
+      device_index[device] = devices.size();
+      Device d;
+      d.id = device;
+      d.samples = samples;
+      d.count = count;
+      devices.push_back(std::move(d));
+      return true;
+    }
+
+    /*!
+    *  @brief  Process the full history of every device, in parallel across devices, replacing any previous checkpoints
+    *  @param  threads
+    *          Number of worker threads, or zero for the number of hardware threads
+    *  @param  configure
+    *          Configures each device's core before its first sample. Called on a worker thread.
+    *  @param  result
+    *          Optional, receives each processed sample with the device's core. Called on a worker thread, with each device's samples in order.
+    */
+    void run(int threads, ConfigureCallback configure, ResultCallback result = ResultCallback())
+    {
+      parallelFor(devices.size(), threads, [&](size_t i) { runDevice(devices[i], configure, result); });
+    }
+
+    /*!
+    *  @brief  Re-run parts of the histories from their checkpoints, in parallel across re-runs. Checkpoints are not changed, so re-runs with different
+    *          settings from the same checkpoint are independent. run() must have completed first.
+    *  @param  reruns
+    *          Re-runs to perform. A re-run of an unknown device, or of a device without samples, produces no results.
+    *  @param  threads
+    *          Number of worker threads, or zero for the number of hardware threads
+    *  @param  result
+    *          Receives each processed sample with the index of its re-run. Called on a worker thread, with each re-run's samples in order.
+    */
+    void rerun(const std::vector<Rerun>& reruns, int threads, RerunResultCallback result)
+    {
+      parallelFor(reruns.size(), threads, [&](size_t r)
+      {
+        const Rerun& job = reruns[r];
+        typename std::unordered_map<uint32_t, size_t>::const_iterator it = device_index.find(job.device);
+        if (it == device_index.end()) return;
+        const Device& device = devices[it->second];
+        const Checkpoint* checkpoint = findCheckpoint(device, job.from);
+        if (checkpoint == nullptr) return;
+        Core core(*checkpoint->core);
+        if (job.reconfigure) job.reconfigure(core);
+        for (size_t i = checkpoint->index; i < device.count; i++)
+        {
+          const IAQSample& sample = device.samples[i];
+          core.process(sample.timestamp, sample.temperature, sample.humidity, sample.pressure, sample.gas_resistance);
+          if (result) result(r, i, sample, core);
+        }
+      });
+    }
+
+    /*!
+    *  @brief  Get the index of the sample a re-run from the given time would start at
+    *  @return Sample index, the number of samples if run() has not processed the device, or zero if the device is unknown
+    */
+    size_t getRerunStart(uint32_t device, unsigned long from) const
+    {
+      typename std::unordered_map<uint32_t, size_t>::const_iterator it = device_index.find(device);
+      if (it == device_index.end()) return 0;
+      const Checkpoint* checkpoint = findCheckpoint(devices[it->second], from);
+      return checkpoint != nullptr ? checkpoint->index : devices[it->second].count;
+    }
+
+    // Number of checkpoints held for all devices
+    size_t getCheckpointCount(void) const
+    {
+      size_t count = 0;
+      for (size_t i = 0; i < devices.size(); i++) count += devices[i].checkpoints.size();
+      return count;
+    }
+
+};
+
+// Backfill with the default policy
+typedef IAQBackfillT<> IAQBackfill;
+typedef IAQBackfillRerunT<> IAQBackfillRerun;
+
+#endif
@@ -0,0 +1,614 @@
+/**
+ * @file  IAQBatch.h
+ * @brief Structure-of-arrays IAQ engine for gateways that run the SE_BME680 algorithm for thousands of remote sensors at a common polling interval.
+ *        Every per-sensor state variable of IAQCore is a column, and each tick of readings for all sensors is processed phase by phase in tight loops
+ *        (compensation, smoothing, humidity factor, calibration, scoring). The loops without data-dependent control flow are left to the compiler to vectorize.
+ *        The calibration arrays are kept apart from the per-tick columns, so a tick only touches them when a sensor's gas ceiling actually changes.
+ *
+ *        Results are identical to IAQCore with the default policy and the same configuration (compare with the same compiler flags, since floating point
+ *        contraction can differ between builds), unless the vectorized math of IAQVectorMath is enabled with setVectorMath(). Supported: temperature compensation, humidity compensation, dew point, gas limits, slope factor,
+ *        calibration timings, and Donchian (with the default full precision storage) or exponential smoothing. Not supported: the gas spike filter, automatic smoothing periods,
+ *        lazy evaluation, derived metrics and custom policies. Builds with quantized or block-summarized Donchian histories, or without the IAQ or smoothing
+ *        subsystems, are rejected at compile time. extras/gateway_check verifies the equivalence for a given build.
+ *
+ *        Host only (uses the C++ standard library). Include with -I pointing at the library's src directory.
+ */
+
+#ifndef __IAQ_BATCH_H__
+#define __IAQ_BATCH_H__
+
+#include <IAQCore.h>
+#include "IAQVectorMath.h"
+#include <stdint.h>
+#include <vector>
+
+// The batch reimplements the gas calibration and the full precision, per-sample Donchian history of IAQCore, so refuse configurations it cannot reproduce
+#if !SE_BME680_ENABLE_IAQ || !SE_BME680_ENABLE_SMOOTHING
+#error "IAQBatch needs the IAQ and smoothing subsystems (SE_BME680_ENABLE_IAQ and SE_BME680_ENABLE_SMOOTHING)"
+#endif
+#if SE_BME680_QUANTIZED_SMOOTHING || SE_BME680_DONCHIAN_BLOCK_SIZE > 0
+#error "IAQBatch only matches IAQCore with full precision per-sample Donchian histories (SE_BME680_QUANTIZED_SMOOTHING and SE_BME680_DONCHIAN_BLOCK_SIZE must be 0)"
+#endif
+
+/*!
+*  @brief  IAQ engine for a fixed set of sensors sharing one configuration, with per-sensor state in columns
+*/
+class IAQBatch
+{
+  private:
+    int sensors = 0; // Number of sensors
+
+    // Shared configuration, same meaning and defaults as in IAQCore
+    float temperature_offset = -2.00F;
+    uint32_t gas_resistance_limit_min = 50000;
+    uint32_t gas_resistance_limit_max = 225000;
+    int gas_calibration_init_time = 30*1000;
+    int gas_calibration_burnin_time = 5*60*1000;
+    int gas_calibration_decay_time = 30*60*1000;
+    MagnusGasCompensation gas_compensation; // Stateless apart from the slope factor, so one instance serves all sensors
+    double slope_factor = 0.03; // Copy of the slope factor for the vectorized humidity factor
+    bool vector_math = false; // Whether exp() and log() are evaluated over whole columns with IAQVectorMath
+
+    // Smoothing configuration: 0 = none, 1 = Donchian, 2 = exponential
+    int smoothing_mode = 0;
+    int smoothing_periods = 0;
+    float range_limit[3] = { 0.0F, 0.0F, 0.0F }; // Temperature, humidity, gas resistance
+    float alpha_slow = 1.0F, alpha_fast = 0.0F; // Exponential smoothing factors
+
+    // Calibration state, one entry per sensor (see StagedGasCeilingT)
+    std::vector<double> gas_ceiling;
+    std::vector<unsigned long> gas_calibration_timer;
+    std::vector<float> gas_calibration_range;
+    std::vector<int32_t> sensor_uptime;
+    std::vector<uint32_t> gas_stage_0_last_low;
+    std::vector<uint8_t> gas_calibration_stage;
+    std::vector<uint8_t> gas_stage_0_low_count;
+    std::vector<uint8_t> gas_calibration_data_index;
+
+    // Calibration arrays, GAS_CALIBRATION_DATA_POINTS per sensor, only touched when a sensor's calibration data changes
+    std::vector<double> gas_calibration_data;
+
+    // Smoothing state. Donchian histories are smoothing_periods per sensor and channel, exponential averages are one slow and one fast value per sensor and channel.
+    std::vector<float> donchian_data; // [channel][sensor][period]
+    std::vector<int> donchian_cursor;
+    std::vector<uint8_t> donchian_full;
+    std::vector<float> exponential_slow; // [channel][sensor]
+    std::vector<float> exponential_fast; // [channel][sensor]
+    std::vector<uint8_t> exponential_seeded;
+
+    // Scratch columns for one tick
+    std::vector<float> smoothed_temperature, smoothed_humidity;
+    std::vector<uint32_t> smoothed_gas, filtered_gas;
+    std::vector<double> compensated_gas_r, compensated_gas_r_min;
+    std::vector<int> active; // Indices of the sensors whose reading reaches the calibration in this tick
+    std::vector<float> math_log, math_arg, math_exp, math_exp_compensated; // Vector math arguments and results for phase 1, allocated by setVectorMath()
+    std::vector<double> math_factor; // Vector math arguments and results for phase 3
+
+    // Track a new data point in one Donchian history and return the Donchian average, exactly as DonchianAverage::track() with full precision storage
+    float donchianTrack(float* data, int cursor, bool full, float dataPoint, float rangeLimitMax) const
+    {
+      int size = smoothing_periods;
+      int j = full ? size : cursor;
+      int k = cursor - 1;
+      if (k < 0) k = size - 1;
+      float min, max;
+      min = max = data[k];
+      for (int i = 1; i < j; i++)
+      {
+        k--;
+        if (k < 0) k = size - 1;
+        float d = data[k];
+        if (d < min) min = d;
+        else if (d > max) max = d;
+        else continue;
+        if (rangeLimitMax != 0.0F && (max - min) > rangeLimitMax)
+        {
+          if (max - dataPoint < dataPoint - min) min = max - rangeLimitMax;
+          else max = min + rangeLimitMax;
+          break;
+        }
+      }
+      return (min + max) / 2.0F;
+    }
+
+    // QuadraticIAQScore::score() with the square as a multiplication, for the vector math path
+    static float quadraticScore(double compensated_gas_r, double gas_ceiling)
+    {
+      double ratio = compensated_gas_r / gas_ceiling;
+      double quality = ratio * ratio * 100.0;
+      return (float)quality < 100.0F ? (float)quality : 100.0F; // Ensure IAQ does not exceed 100%
+    }
+
+    // Track a new data point in one exponential average and return the smoothed value, exactly as ExponentialAverage::track()
+    float exponentialTrack(float& slow, float& fast, bool seeded, float dataPoint, float rangeLimitMax) const
+    {
+      if (!seeded)
+      {
+        slow = fast = dataPoint;
+        return dataPoint;
+      }
+      slow += alpha_slow * (dataPoint - slow);
+      if (alpha_fast > 0.0F)
+      {
+        fast += alpha_fast * (dataPoint - fast);
+        if (rangeLimitMax != 0.0F)
+        {
+          if (fast - slow > rangeLimitMax) slow = fast - rangeLimitMax;
+          else if (slow - fast > rangeLimitMax) slow = fast + rangeLimitMax;
+        }
+      }
+      else
+      {
+        fast = slow;
+      }
+      return slow;
+    }
+
+    // Add a compensated gas reading to a sensor's calibration data and update its gas ceiling, exactly as StagedGasCeilingT::updateGasCalibration()
+    void updateGasCalibration(int s, double compensated_gas, bool replaceSmallest)
+    {
+      double* data = &gas_calibration_data[(size_t)s * GAS_CALIBRATION_DATA_POINTS];
+      if (replaceSmallest && data[GAS_CALIBRATION_DATA_POINTS - 1] > 0)
+      {
+        double smallest_value = data[0];
+        int smallest_index = 0;
+        for (int i = 1; i < GAS_CALIBRATION_DATA_POINTS; i++)
+        {
+          if (data[i] < smallest_value)
+          {
+            smallest_value = data[i];
+            smallest_index = i;
+          }
+        }
+        if (compensated_gas > smallest_value) data[smallest_index] = compensated_gas;
+      }
+      else
+      {
+        data[gas_calibration_data_index[s]] = compensated_gas;
+        if (++gas_calibration_data_index[s] >= GAS_CALIBRATION_DATA_POINTS) gas_calibration_data_index[s] = 0;
+      }
+
+      // Arithmetic mean and min/max range of the (possibly partially populated) calibration data
+      double calMin = 0, calMax = 0, sum = 0;
+      int count = 0;
+      for (int i = 0; i < GAS_CALIBRATION_DATA_POINTS; i++)
+      {
+        double dataPoint = data[i];
+        if (dataPoint > 0)
+        {
+          sum += dataPoint;
+          if (calMin == 0) calMin = dataPoint; else if (dataPoint < calMin) calMin = dataPoint;
+          if (calMax == 0) calMax = dataPoint; else if (dataPoint > calMax) calMax = dataPoint;
+          count++;
+        }
+      }
+      if (count)
+      {
+        if (calMax > 0) gas_calibration_range[s] = (float)((calMax - calMin) / calMax);
+        double mean = sum / (double)count;
+        if (!isnan(mean)) gas_ceiling[s] = mean;
+      }
+    }
+
+    // Advance a sensor's calibration stages with a new reading, exactly as StagedGasCeilingT::update()
+    void updateCalibration(int s, unsigned long now, uint32_t gas_resistance, double compensated_gas_r, double compensated_gas_r_min)
+    {
+      switch (gas_calibration_stage[s])
+      {
+        case 0: // Initialization
+          if (now - gas_calibration_timer[s] >= (unsigned long)gas_calibration_init_time)
+          {
+            if (gas_stage_0_last_low[s] == 0 || gas_resistance < gas_stage_0_last_low[s])
+            {
+              gas_stage_0_last_low[s] = gas_resistance;
+              gas_stage_0_low_count[s] = 0;
+            }
+            else if (gas_resistance > gas_stage_0_last_low[s] && ++gas_stage_0_low_count[s] >= 3)
+            {
+              gas_calibration_timer[s] = now;
+              gas_calibration_stage[s] = 1;
+            }
+          }
+          break;
+
+        case 1: // Burn-in
+          if (now - gas_calibration_timer[s] < (unsigned long)gas_calibration_burnin_time || gas_calibration_data[((size_t)s + 1) * GAS_CALIBRATION_DATA_POINTS - 1] == 0)
+          {
+            updateGasCalibration(s, compensated_gas_r > compensated_gas_r_min ? compensated_gas_r : compensated_gas_r_min, true);
+          }
+          else
+          {
+            gas_calibration_timer[s] = now;
+            gas_calibration_stage[s] = 2;
+          }
+          break;
+
+        case 2: // Normal operation
+          if (compensated_gas_r > compensated_gas_r_min)
+          {
+            if (compensated_gas_r > gas_ceiling[s])
+            {
+              updateGasCalibration(s, compensated_gas_r, true);
+            }
+            else if (now - gas_calibration_timer[s] >= (unsigned long)gas_calibration_decay_time)
+            {
+              updateGasCalibration(s, compensated_gas_r, false);
+              gas_calibration_timer[s] = now;
+              sensor_uptime[s]++;
+            }
+          }
+          break;
+      }
+    }
+
+    // Estimated IAQ accuracy of a sensor, exactly as StagedGasCeilingT::getAccuracy()
+    int accuracy(int s) const
+    {
+      if (gas_calibration_stage[s] < 2) return gas_calibration_stage[s]; // 0 = unreliable during initialization, 1 = low during burn-in
+      float range = gas_calibration_range[s];
+      int a = 1;
+      if (range < 0.080F) a = 2;
+      if (range < 0.035F && sensor_uptime[s] >= 2) a = 3;
+      if (range < 0.020F && sensor_uptime[s] >= 100) a = 4;
+      return a;
+    }
+
+  public:
+    // Outputs, one entry per sensor, assigned by process() for the sensors that had a reading in the tick
+    std::vector<float> temperature_compensated; // Compensated temperature (Celsius)
+    std::vector<float> humidity_compensated; // Compensated humidity (RH %)
+    std::vector<float> dew_point; // Dew point (Celsius)
+    std::vector<float> IAQ; // Indoor Air Quality (0-100%, bad to good), 50% until the first score
+    std::vector<uint8_t> IAQ_accuracy; // 0 = unreliable, 1 = low, 2 = moderate, 3 = high, 4 = very high
+
+    /*!
+    *  @brief  Allocate the columns for a fixed number of sensors, with gas calibration starting at timestamp zero
+    *  @param  sensorCount
+    *          Number of sensors, indexed 0 to sensorCount - 1 in every call
+    */
+    explicit IAQBatch(int sensorCount) : sensors(sensorCount > 0 ? sensorCount : 0)
+    {
+      size_t n = (size_t)sensors;
+      gas_ceiling.resize(n);
+      gas_calibration_timer.resize(n);
+      gas_calibration_range.resize(n);
+      sensor_uptime.resize(n);
+      gas_stage_0_last_low.resize(n);
+      gas_calibration_stage.resize(n);
+      gas_stage_0_low_count.resize(n);
+      gas_calibration_data_index.resize(n);
+      gas_calibration_data.resize(n * GAS_CALIBRATION_DATA_POINTS);
+      smoothed_temperature.resize(n);
+      smoothed_humidity.resize(n);
+      smoothed_gas.resize(n);
+      filtered_gas.resize(n);
+      compensated_gas_r.resize(n);
+      compensated_gas_r_min.resize(n);
+      active.resize(n);
+      temperature_compensated.assign(n, NAN);
+      humidity_compensated.assign(n, NAN);
+      dew_point.assign(n, NAN);
+      IAQ.resize(n);
+      IAQ_accuracy.resize(n);
+      for (int s = 0; s < sensors; s++) resetCalibration(s, 0);
+    }
+
+    // Number of sensors
+    int size(void) const { return sensors; }
+
+    /*!
+    *  @brief  Set temperature compensation for all sensors
+    *  @param  degreesC
+    *          Temperature offset in degrees Celsius added to the raw temperature
+    */
+    void setTemperatureCompensation(float degreesC) { temperature_offset = degreesC; }
+
+    /*!
+    *  @brief  Set the gas resistance compensation slope factor for all sensors
+    *  @return True if the slope factor was set successfully
+    */
+    bool setGasCompensationSlopeFactor(double slopeFactor = 0.03)
+    {
+      if (!gas_compensation.setSlopeFactor(slopeFactor)) return false;
+      slope_factor = slopeFactor;
+      return true;
+    }
+
+    /*!
+    *  @brief  Evaluate exp() and log() over whole columns with the vectorized kernels of IAQVectorMath (AVX2 or NEON when the CPU supports them),
+    *          for the compensation, the dew point and the humidity factor, and square the score ratio with a multiplication instead of pow().
+    *          The affected values differ from IAQCore by a few ulp (see IAQVectorMath.h), and the Magnus table setting does not apply.
+    *  @param  enabled
+    *          True to use the vectorized math, false (the default) for results identical to IAQCore
+    */
+    void setVectorMath(bool enabled)
+    {
+      vector_math = enabled;
+      size_t n = enabled ? (size_t)sensors : 0;
+      math_log.assign(n, 0.0F);
+      math_arg.assign(n, 0.0F);
+      math_exp.assign(n, 0.0F);
+      math_exp_compensated.assign(n, 0.0F);
+      math_factor.assign(n, 0.0);
+    }
+
+    /*!
+    *  @brief  Set the lower and upper "high" gas resistance limits for gas calibration, with the same validation as IAQCore
+    *  @return True if the limits were set successfully, false if they are invalid
+    */
+    bool setUpperGasResistanceLimits(uint32_t minLimit = 30000, uint32_t maxLimit = 225000)
+    {
+      if (!(minLimit >= 30000 && maxLimit <= 2000000 && minLimit <= maxLimit)) return false;
+      gas_resistance_limit_min = minLimit;
+      gas_resistance_limit_max = maxLimit;
+      return true;
+    }
+
+    /*!
+    *  @brief  Set minimum timings for the gas calibration stages, with the same validation and minimums as IAQCore
+    *  @return True if the timings were set successfully, false if they are invalid
+    */
+    bool setGasCalibrationTimings(int initTime = 30 * 1000, int burninTime = 5 * 60 * 1000, int decayTime = 30 * 60 * 1000)
+    {
+      if (!(initTime > 0 && burninTime >= initTime && decayTime >= burninTime)) return false;
+      if (initTime < 1000) initTime = 1000; // Minimum 1 second for initialization
+      if (burninTime < initTime + 1000) burninTime = initTime + 1000; // Minimum 1 second after initialization for burn-in
+      if (decayTime < burninTime + 60000) decayTime = burninTime + 60000; // Minimum 1 minute after burn-in for decay
+      gas_calibration_init_time = initTime;
+      gas_calibration_burnin_time = burninTime;
+      gas_calibration_decay_time = decayTime;
+      return true;
+    }
+
+    /*!
+    *  @brief  Enable or disable Donchian smoothing for all sensors, replacing exponential smoothing. Histories are cleared.
+    *  @param  periods
+    *          Number of periods (at least 2). Memory is 12 bytes per period and sensor.
+    *  @return True if smoothing was configured successfully, false if the parameters are invalid or the histories cannot be sized
+    */
+    bool setDonchianSmoothing(bool enabled, int periods = 200, float temperatureRangeLimitMax = 0.0F, float humidityRangeLimitMax = 0.0F, float gasResistanceRangeLimitMax = 0.0F)
+    {
+      if (!enabled)
+      {
+        if (smoothing_mode == 1) smoothing_mode = 0;
+        std::vector<float>().swap(donchian_data);
+        return true;
+      }
+      if (periods < 2) return false;
+      size_t channels = 3 * (size_t)sensors; // Histories of all sensors are one column of 3 * sensors * periods floats
+      if (channels > 0 && (size_t)periods > donchian_data.max_size() / channels) return false; // Size overflows
+      smoothing_mode = 1;
+      smoothing_periods = periods;
+      range_limit[0] = temperatureRangeLimitMax;
+      range_limit[1] = humidityRangeLimitMax;
+      range_limit[2] = gasResistanceRangeLimitMax;
+      donchian_data.assign(3 * (size_t)sensors * periods, 0.0F);
+      donchian_cursor.assign(sensors, 0);
+      donchian_full.assign(sensors, 0);
+      return true;
+    }
+
+    /*!
+    *  @brief  Enable or disable exponential smoothing for all sensors, replacing Donchian smoothing. Averages restart with the next reading.
+    *  @return True if smoothing was configured successfully, false if the parameters are invalid (same rules as IAQCore)
+    */
+    bool setExponentialSmoothing(bool enabled, int periods = 200, int fastPeriods = 0, float temperatureRangeLimitMax = 0.0F, float humidityRangeLimitMax = 0.0F, float gasResistanceRangeLimitMax = 0.0F)
+    {
+      if (!enabled)
+      {
+        if (smoothing_mode == 2) smoothing_mode = 0;
+        return true;
+      }
+      if (periods < 2 || fastPeriods < 0 || fastPeriods >= periods) return false;
+      std::vector<float>().swap(donchian_data);
+      smoothing_mode = 2;
+      smoothing_periods = periods;
+      range_limit[0] = temperatureRangeLimitMax;
+      range_limit[1] = humidityRangeLimitMax;
+      range_limit[2] = gasResistanceRangeLimitMax;
+      alpha_slow = 2.0F / (float)(periods + 1);
+      alpha_fast = fastPeriods > 0 ? 2.0F / (float)(fastPeriods + 1) : 0.0F;
+      exponential_slow.assign(3 * (size_t)sensors, 0.0F);
+      exponential_fast.assign(3 * (size_t)sensors, 0.0F);
+      exponential_seeded.assign(sensors, 0);
+      return true;
+    }
+
+    /*!
+    *  @brief  Restart gas calibration of one sensor from the initialization stage
+    *  @param  sensor
+    *          Sensor index
+    *  @param  now
+    *          Timestamp in milliseconds, on the same clock as process()
+    */
+    void resetCalibration(int sensor, unsigned long now)
+    {
+      double* data = &gas_calibration_data[(size_t)sensor * GAS_CALIBRATION_DATA_POINTS];
+      for (int i = 0; i < GAS_CALIBRATION_DATA_POINTS; i++) data[i] = 0;
+      gas_ceiling[sensor] = 0;
+      gas_calibration_timer[sensor] = now;
+      gas_calibration_range[sensor] = 1.0F;
+      sensor_uptime[sensor] = 0;
+      gas_stage_0_last_low[sensor] = 0;
+      gas_calibration_stage[sensor] = 0;
+      gas_stage_0_low_count[sensor] = 0;
+      gas_calibration_data_index[sensor] = 0;
+      IAQ[sensor] = 50.0F;
+      IAQ_accuracy[sensor] = 0;
+    }
+
+    /*!
+    *  @brief  Process one tick of readings for all sensors
+    *  @param  timestamp
+    *          Time of the tick in milliseconds
+    *  @param  temperature
+    *          Raw temperatures in degrees Celsius, one per sensor
+    *  @param  humidity
+    *          Raw relative humidities in RH %, one per sensor
+    *  @param  gas_resistance
+    *          Raw gas resistances in ohms, one per sensor
+    *  @param  valid
+    *          Optional flags, one per sensor: sensors with a zero flag have no reading in this tick and are left untouched. Null means all sensors have a reading.
+    */
+    void process(unsigned long timestamp, const float* temperature, const float* humidity, const uint32_t* gas_resistance, const uint8_t* valid = nullptr)
+    {
+      const int n = sensors;
+      float* tc = temperature_compensated.data();
+      float* hc = humidity_compensated.data();
+      float* dp = dew_point.data();
+
+      // Phase 1: temperature and humidity compensation and dew point, with the same expressions as IAQCore
+      if (vector_math)
+      {
+        // Arguments for all sensors (neutral ones without a reading), one pass of each function over the columns, then the same expressions
+        for (int s = 0; s < n; s++)
+        {
+          bool has = !valid || valid[s];
+          float t = has ? temperature[s] : 0.0F, h = has ? humidity[s] : 100.0F;
+          float c = t + temperature_offset;
+          math_log[s] = h / 100.0F;
+          math_arg[s] = 17.625F * t / (243.04F + t);
+          math_exp_compensated[s] = 17.625F * c / (243.04F + c);
+        }
+        IAQVectorMath::log(math_log.data(), math_log.data(), n);
+        IAQVectorMath::exp(math_arg.data(), math_exp.data(), n);
+        IAQVectorMath::exp(math_exp_compensated.data(), math_exp_compensated.data(), n);
+        for (int s = 0; s < n; s++)
+        {
+          if (valid && !valid[s]) continue;
+          float h = humidity[s];
+          float magnusGammaTRH = math_log[s] + math_arg[s];
+          dp[s] = 243.04F * magnusGammaTRH / (17.625F - magnusGammaTRH);
+          float avpMeasured = h / 100.0F * (6.112F * math_exp[s]);
+          hc[s] = avpMeasured / (6.112F * math_exp_compensated[s]) * 100.0F;
+          tc[s] = temperature[s] + temperature_offset;
+        }
+      }
+      else for (int s = 0; s < n; s++)
+      {
+        if (valid && !valid[s]) continue;
+        float t = temperature[s], h = humidity[s];
+        float c = t + temperature_offset;
+        float magnusGammaTRH = (float)log(h / 100.0F) + 17.625F * t / (243.04F + t);
+        dp[s] = 243.04F * magnusGammaTRH / (17.625F - magnusGammaTRH);
+        float avpMeasured = h / 100.0F * magnusSaturationVaporPressure(t);
+        hc[s] = avpMeasured / magnusSaturationVaporPressure(c) * 100.0F;
+        tc[s] = c;
+      }
+
+      // Phase 2: drop out-of-range gas readings and apply smoothing, which only starts after the initialization stage
+      int m = 0;
+      for (int s = 0; s < n; s++)
+      {
+        if (valid && !valid[s]) continue;
+        uint32_t gas = gas_resistance[s];
+        if (gas > gas_resistance_limit_max)
+        {
+          if (gas_calibration_stage[s] < 2) gas_calibration_timer[s] += 1000; // Allow more time to stabilize
+          continue;
+        }
+        float t = temperature[s], h = humidity[s];
+        uint32_t g = gas;
+        if (smoothing_mode != 0 && gas_calibration_stage[s] >= 1)
+        {
+          float gs;
+          if (smoothing_mode == 1)
+          {
+            // Donchian histories share one cursor per sensor
+            size_t stride = (size_t)sensors * smoothing_periods;
+            float* d = &donchian_data[(size_t)s * smoothing_periods];
+            int cursor = donchian_cursor[s];
+            d[cursor] = t;
+            d[stride + cursor] = h;
+            d[2 * stride + cursor] = (float)gas;
+            if (++cursor >= smoothing_periods)
+            {
+              cursor = 0;
+              donchian_full[s] = 1;
+            }
+            donchian_cursor[s] = cursor;
+            t = donchianTrack(d, cursor, donchian_full[s], t, range_limit[0]);
+            h = donchianTrack(d + stride, cursor, donchian_full[s], h, range_limit[1]);
+            gs = donchianTrack(d + 2 * stride, cursor, donchian_full[s], (float)gas, range_limit[2]);
+          }
+          else
+          {
+            bool seeded = exponential_seeded[s];
+            t = exponentialTrack(exponential_slow[s], exponential_fast[s], seeded, t, range_limit[0]);
+            h = exponentialTrack(exponential_slow[n + s], exponential_fast[n + s], seeded, h, range_limit[1]);
+            gs = exponentialTrack(exponential_slow[2 * n + s], exponential_fast[2 * n + s], seeded, (float)gas, range_limit[2]);
+            exponential_seeded[s] = 1;
+          }
+          g = (uint32_t)round(gs);
+        }
+        smoothed_temperature[m] = t;
+        smoothed_humidity[m] = h;
+        smoothed_gas[m] = g;
+        filtered_gas[m] = gas;
+        active[m++] = s;
+      }
+
+      // Phase 3: humidity compensation of the gas resistance
+      if (vector_math)
+      {
+        // Saturation vapor density and factor as in MagnusGasCompensation::factor(), with one pass of exp() over the column for each
+        double* f = math_factor.data();
+        for (int i = 0; i < m; i++)
+        {
+          float t = smoothed_temperature[i];
+          f[i] = 17.625 * t / (243.04 + t);
+        }
+        IAQVectorMath::exp(f, f, m);
+        for (int i = 0; i < m; i++)
+        {
+          float t = smoothed_temperature[i];
+          double svd = (6.112 * 100.0 * f[i]) / (461.52 * (t + 273.15));
+          double hum_abs = smoothed_humidity[i] * 10 * svd;
+          f[i] = slope_factor * hum_abs;
+        }
+        IAQVectorMath::exp(f, f, m);
+        for (int i = 0; i < m; i++)
+        {
+          compensated_gas_r[i] = (double)smoothed_gas[i] * f[i];
+          compensated_gas_r_min[i] = (double)gas_resistance_limit_min * f[i];
+        }
+      }
+      else for (int i = 0; i < m; i++)
+      {
+        double factor = gas_compensation.factor(smoothed_temperature[i], smoothed_humidity[i]);
+        compensated_gas_r[i] = (double)smoothed_gas[i] * factor;
+        compensated_gas_r_min[i] = (double)gas_resistance_limit_min * factor;
+      }
+
+      // Phase 4: calibration stages and gas ceilings, then the score and accuracy
+      for (int i = 0; i < m; i++)
+      {
+        int s = active[i];
+        if (isnan(compensated_gas_r[i]) || isnan(compensated_gas_r_min[i])) continue;
+        updateCalibration(s, timestamp, filtered_gas[i], compensated_gas_r[i], compensated_gas_r_min[i]);
+        if (gas_ceiling[s]) IAQ[s] = vector_math ? quadraticScore(compensated_gas_r[i], gas_ceiling[s]) : QuadraticIAQScore::score(compensated_gas_r[i], gas_ceiling[s]);
+        IAQ_accuracy[s] = (uint8_t)accuracy(s);
+      }
+    }
+
+    /*!
+    *  @brief  Get the current gas calibration stage of a sensor
+    *  @return 0 = initialization, 1 = burn-in, 2 = normal operation
+    */
+    int getGasCalibrationStage(int sensor) const { return gas_calibration_stage[sensor]; }
+
+    /*!
+    *  @brief  Get the memory used by the columns
+    *  @return Bytes per sensor
+    */
+    size_t getBytesPerSensor(void) const
+    {
+      size_t bytes = sizeof(double) * (1 + GAS_CALIBRATION_DATA_POINTS + 2) + sizeof(unsigned long) + sizeof(float) * 7 + sizeof(int32_t) + sizeof(uint32_t) * 3 + 4 + sizeof(int);
+      if (smoothing_mode == 1) bytes += sizeof(float) * 3 * smoothing_periods + sizeof(int) + 1;
+      if (smoothing_mode == 2) bytes += sizeof(float) * 6 + 1;
+      if (vector_math) bytes += sizeof(float) * 4 + sizeof(double);
+      return bytes;
+    }
+};
+
+#endif
@@ -0,0 +1,240 @@
+/**
+ * @file  IAQDevicePool.h
+ * @brief Device state storage for gateways, split into a hot record and a cold object per device.
+ *        Hot records (device id, slot and whatever the owner reads on every reading or in scans over all devices) are kept in one dense array,
+ *        so a scan over all devices reads consecutive cache lines, and removing a device moves the last record into its place. An open-addressing
+ *        index maps device ids to records without a heap node per device.
+ *        Cold objects (the IAQ core with its calibration array, configuration and smoothing state) are constructed in place in fixed-size slabs,
+ *        optionally followed by a per-device block of floats for the Donchian smoothing history. Slots of removed devices are reused by the next
+ *        device added, so adding and removing devices only ever allocates whole slabs, and never frees memory into a fragmented heap.
+ *
+ *        Host only (uses the C++ standard library).
+ */
+
+#ifndef __IAQ_DEVICE_POOL_H__
+#define __IAQ_DEVICE_POOL_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <memory>
+#include <new>
+#include <vector>
+
+/*!
+*  @brief  Dense hot records and slab-pooled cold objects for many devices
+*  @tparam Hot
+*          Hot record type with uint32_t members device and slot, which the pool assigns. Other members are value-initialized when a device is added.
+*  @tparam Cold
+*          Cold object type, default-constructed in its slot when a device is added and destroyed when it is removed
+*  @tparam SlabSize
+*          Number of cold objects per slab
+*/
+template <class Hot, class Cold, int SlabSize = 64>
+class IAQDevicePoolT
+{
+  private:
+    std::vector<Hot> hot; // Dense, in no particular order
+    std::vector<uint32_t> index; // Open addressing by device id with linear probing: record index + 1, or zero when the bucket is free
+    uint32_t index_mask = 0; // Index size - 1, where the size is a power of 2
+    std::vector<std::unique_ptr<char[]> > slabs; // Cold slots, never moved or freed while the pool exists
+    std::vector<uint32_t> free_slots; // Slots of removed devices, reused last in first out
+    uint32_t slot_count = 0; // Slots handed out so far, including free ones
+    size_t slot_stride = 0; // Bytes per slot: the cold object followed by the extra floats
+    int extra_floats = 0; // Floats per slot after the cold object
+
+    // Bucket of a device id. The ids are mixed (MurmurHash3 finalizer) since the engine already shards devices by the high bits of a multiplicative hash.
+    uint32_t bucket(uint32_t device) const
+    {
+      uint32_t h = device;
+      h ^= h >> 16;
+      h *= 0x85EBCA6Bu;
+      h ^= h >> 13;
+      h *= 0xC2B2AE35u;
+      h ^= h >> 16;
+      return h & index_mask;
+    }
+
+    // Index bucket holding a device, or the free bucket where it would go
+    uint32_t probe(uint32_t device) const
+    {
+      uint32_t i = bucket(device);
+      while (index[i] != 0 && hot[index[i] - 1].device != device) i = (i + 1) & index_mask;
+      return i;
+    }
+
+    // Rebuild the index with a new size, keeping the load factor at or below one half
+    void rehash(uint32_t size)
+    {
+      index.assign(size, 0);
+      index_mask = size - 1;
+      for (size_t r = 0; r < hot.size(); r++) index[probe(hot[r].device)] = (uint32_t)r + 1;
+    }
+
+    // Address of a cold slot
+    char* slotAddress(uint32_t slot) const
+    {
+      return slabs[slot / SlabSize].get() + (size_t)(slot % SlabSize) * slot_stride;
+    }
+
+    // Bytes per slot for the current number of extra floats, keeping every cold object aligned
+    size_t stride(void) const
+    {
+      const size_t align = alignof(Cold) > alignof(double) ? alignof(Cold) : alignof(double);
+      size_t bytes = (sizeof(Cold) + align - 1) / align * align;
+      bytes += (size_t)extra_floats * sizeof(float);
+      return (bytes + align - 1) / align * align;
+    }
+
+  public:
+    // Constructor
+    IAQDevicePoolT()
+    {
+      slot_stride = stride();
+      rehash(16);
+    }
+
+    // Destructor, which destroys the cold objects of all devices
+    ~IAQDevicePoolT()
+    {
+      clear();
+    }
+
+    IAQDevicePoolT(const IAQDevicePoolT&) = delete;
+    IAQDevicePoolT& operator=(const IAQDevicePoolT&) = delete;
+
+    /*!
+    *  @brief  Reserve a block of floats after each cold object, e.g. for IAQCoreT::setSmoothingBuffer(). Only possible while no slabs are allocated.
+    *  @param  floats
+    *          Floats per device, or zero for none
+    *  @return True if the block size was set, false if the pool already has slabs or the size is invalid
+    */
+    bool setExtraFloats(int floats)
+    {
+      if (floats < 0 || !slabs.empty()) return false;
+      extra_floats = floats;
+      slot_stride = stride();
+      return true;
+    }
+
+    // Floats per device after each cold object
+    int getExtraFloats(void) const { return extra_floats; }
+
+    /*!
+    *  @brief  Find the hot record of a device
+    *  @return Hot record, or null if the device has not been added. Valid until the next add() or remove().
+    */
+    Hot* find(uint32_t device)
+    {
+      uint32_t r = index[probe(device)];
+      return r != 0 ? &hot[r - 1] : nullptr;
+    }
+
+    /*!
+    *  @brief  Add a device, constructing its cold object in a free slot
+    *  @return Hot record of the device, which is the existing record if the device was already added. Valid until the next add() or remove().
+    */
+    Hot& add(uint32_t device)
+    {
+      uint32_t i = probe(device);
+      if (index[i] != 0) return hot[index[i] - 1];
+
+      uint32_t slot;
+      if (!free_slots.empty())
+      {
+        slot = free_slots.back();
+        free_slots.pop_back();
+      }
+      else
+      {
+        if (slot_count % SlabSize == 0) slabs.emplace_back(new char[(size_t)SlabSize * slot_stride]);
+        slot = slot_count++;
+      }
+      new (slotAddress(slot)) Cold();
+
+      Hot record = Hot();
+      record.device = device;
+      record.slot = slot;
+      hot.push_back(record);
+      if ((hot.size() * 2) > (size_t)index_mask + 1) rehash((index_mask + 1) * 2);
+      else index[i] = (uint32_t)hot.size();
+      return hot.back();
+    }
+
+    /*!
+    *  @brief  Remove a device, destroying its cold object and freeing its slot for the next device. The last hot record moves into its place.
+    *  @return True if the device was removed, false if it had not been added
+    */
+    bool remove(uint32_t device)
+    {
+      uint32_t i = probe(device);
+      if (index[i] == 0) return false;
+      uint32_t r = index[i] - 1;
+      uint32_t slot = hot[r].slot;
+      reinterpret_cast<Cold*>(slotAddress(slot))->~Cold();
+      free_slots.push_back(slot);
+
+      // Backward shift deletion, so the probe sequences of the remaining devices stay unbroken without tombstones
+      uint32_t hole = i;
+      for (uint32_t j = (i + 1) & index_mask; index[j] != 0; j = (j + 1) & index_mask)
+      {
+        uint32_t home = bucket(hot[index[j] - 1].device);
+        if (((j - home) & index_mask) >= ((j - hole) & index_mask))
+        {
+          index[hole] = index[j];
+          hole = j;
+        }
+      }
+      index[hole] = 0;
+
+      // Keep the hot records dense
+      uint32_t last = (uint32_t)hot.size() - 1;
+      if (r != last)
+      {
+        hot[r] = hot[last];
+        index[probe(hot[r].device)] = r + 1;
+      }
+      hot.pop_back();
+      return true;
+    }
+
+    /*!
+    *  @brief  Remove all devices. Slabs are kept for the devices added next.
+    */
+    void clear(void)
+    {
+      for (size_t r = 0; r < hot.size(); r++) reinterpret_cast<Cold*>(slotAddress(hot[r].slot))->~Cold();
+      hot.clear();
+      free_slots.clear();
+      for (uint32_t slot = slot_count; slot-- > 0;) free_slots.push_back(slot);
+      rehash(index_mask + 1);
+    }
+
+    // Cold object of a device, at a fixed address until the device is removed
+    Cold& cold(const Hot& record) { return *reinterpret_cast<Cold*>(slotAddress(record.slot)); }
+
+    // Extra floats of a device (see setExtraFloats()), or null if none are reserved
+    float* extra(const Hot& record)
+    {
+      if (extra_floats == 0) return nullptr;
+      const size_t align = alignof(Cold) > alignof(double) ? alignof(Cold) : alignof(double);
+      return reinterpret_cast<float*>(slotAddress(record.slot) + (sizeof(Cold) + align - 1) / align * align);
+    }
+
+    // Number of devices
+    size_t size(void) const { return hot.size(); }
+
+    // Hot record by position, 0 to size() - 1, for scans over all devices
+    Hot& operator[](size_t position) { return hot[position]; }
+    const Hot& operator[](size_t position) const { return hot[position]; }
+
+    /*!
+    *  @brief  Get the memory held by the pool: slabs, hot records, index and free list. Heap memory owned by the cold objects themselves is not included.
+    *  @return Bytes
+    */
+    size_t getMemoryUsage(void) const
+    {
+      return slabs.size() * (size_t)SlabSize * slot_stride + hot.capacity() * sizeof(Hot) + index.capacity() * sizeof(uint32_t) + free_slots.capacity() * sizeof(uint32_t);
+    }
+};
+
+#endif
@@ -0,0 +1,540 @@
+/**
+ * @file  IAQEngine.h
+ * @brief Multi-threaded IAQ processing for gateways that receive readings from many remote sensors.
+ *        Device states are sharded across worker threads by device id. Each shard has a bounded lock-free ingestion queue, and its worker drains the queue in
+ *        batches and is the only thread that touches the shard's device states, so no locks are taken on the processing path.
+ *
+ *        Readings of one device are always processed in the order they were submitted, since a device maps to exactly one queue and one worker.
+ *        Submit the readings of a device from one thread (or otherwise in timestamp order), because calibration timing depends on sample order.
+ *        For links that deliver readings late or out of order, setReorderBuffer() puts a per-device IAQReorderBuffer in front of each core.
+ *
+ *        Each shard keeps its devices in an IAQDevicePool: a dense array of small hot records (id, last timestamp, last IAQ), and the IAQ cores in
+ *        fixed-size slabs whose slots are reused when devices are evicted. setSmoothingPool() also places the Donchian histories in the slabs.
+ *
+ *        Host only (uses the C++11 standard library and threads). Include with -I pointing at the library's src directory, and link with -pthread.
+ */
+
+#ifndef __IAQ_ENGINE_H__
+#define __IAQ_ENGINE_H__
+
+#include <IAQCore.h>
+#include "IAQDevicePool.h"
+#include "IAQReorderBuffer.h"
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+
+/*!
+*  @brief  One raw reading from a remote sensor
+*/
+struct IAQSample
+{
+  uint32_t device; // Device id
+  unsigned long timestamp; // Time of the reading in milliseconds, increasing per device
+  float temperature; // Raw temperature (Celsius)
+  float humidity; // Raw relative humidity (RH %)
+  float pressure; // Raw pressure (Pa)
+  uint32_t gas_resistance; // Raw gas resistance (ohms)
+};
+
+/*!
+*  @brief  Bounded lock-free queue for any number of producers and consumers, using a sequence number per slot (D. Vyukov's bounded MPMC queue)
+*/
+template <class T>
+class IAQSampleQueue
+{
+  private:
+    struct Slot
+    {
+      std::atomic<size_t> sequence; // Ticket of the next push (when equal to the position) or pop (when equal to the position + 1) this slot accepts
+      T value;
+    };
+
+    std::unique_ptr<Slot[]> slots;
+    size_t mask = 0; // Capacity - 1, where the capacity is a power of 2
+    char pad0[64]; // Padding keeps the producer and consumer positions on separate cache lines (alignas is not honored by new before C++17)
+    std::atomic<size_t> head; // Next position to push
+    char pad1[64];
+    std::atomic<size_t> tail; // Next position to pop
+    char pad2[64];
+
+  public:
+    // Constructor, with the capacity rounded up to a power of 2
+    explicit IAQSampleQueue(size_t capacity)
+    {
+      size_t size = 2;
+      while (size < capacity) size <<= 1;
+      slots.reset(new Slot[size]);
+      mask = size - 1;
+      for (size_t i = 0; i < size; i++) slots[i].sequence.store(i, std::memory_order_relaxed);
+      head.store(0, std::memory_order_relaxed);
+      tail.store(0, std::memory_order_relaxed);
+    }
+
+    /*!
+    *  @brief  Add a value to the queue
+    *  @return True if the value was added, false if the queue is full
+    */
+    bool push(const T& value)
+    {
+      size_t position = head.load(std::memory_order_relaxed);
+      for (;;)
+      {
+        Slot& slot = slots[position & mask];
+        size_t sequence = slot.sequence.load(std::memory_order_acquire);
+        intptr_t difference = (intptr_t)sequence - (intptr_t)position;
+        if (difference == 0)
+        {
+          if (head.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+          {
+            slot.value = value;
+            slot.sequence.store(position + 1, std::memory_order_release);
+            return true;
+          }
+        }
+        else if (difference < 0)
+        {
+          return false; // Full
+        }
+        else
+        {
+          position = head.load(std::memory_order_relaxed); // Another producer took this slot
+        }
+      }
+    }
+
+    /*!
+    *  @brief  Remove the oldest value from the queue
+    *  @return True if a value was removed, false if the queue is empty
+    */
+    bool pop(T& value)
+    {
+      size_t position = tail.load(std::memory_order_relaxed);
+      for (;;)
+      {
+        Slot& slot = slots[position & mask];
+        size_t sequence = slot.sequence.load(std::memory_order_acquire);
+        intptr_t difference = (intptr_t)sequence - (intptr_t)(position + 1);
+        if (difference == 0)
+        {
+          if (tail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+          {
+            value = slot.value;
+            slot.sequence.store(position + mask + 1, std::memory_order_release);
+            return true;
+          }
+        }
+        else if (difference < 0)
+        {
+          return false; // Empty
+        }
+        else
+        {
+          position = tail.load(std::memory_order_relaxed); // Another consumer took this slot
+        }
+      }
+    }
+};
+
+/*!
+*  @brief  Sharded multi-threaded IAQ engine with one IAQ core per device
+*  @tparam Core
+*          Per-device IAQ state, IAQCore or an IAQCoreT with a custom policy
+*/
+template <class Core = IAQCore>
+class IAQEngineT
+{
+  public:
+    typedef std::function<void(uint32_t device, Core& core)> ConfigureCallback; // Called on a worker thread when a device is first seen, before its first reading, e.g. to configure the core and restore its saved state
+    typedef std::function<void(const IAQSample& sample, Core& core)> ResultCallback; // Called on a worker thread after each reading has been processed
+    typedef std::function<void(const IAQSample& sample)> LateCallback; // Called on a worker thread for each reading rejected by a reorder buffer
+
+    // Hot per-device record, updated with every processed reading and read by scans over all devices
+    struct DeviceState
+    {
+      uint32_t device; // Device id
+      uint32_t slot; // Slot of the device's core in its shard's pool
+      unsigned long timestamp; // Timestamp of the last processed reading
+#if SE_BME680_ENABLE_IAQ
+      float IAQ; // IAQ member of the core after the last processed reading
+      uint8_t IAQ_accuracy; // IAQ_accuracy member of the core after the last processed reading
+#endif
+      bool started; // Whether the core has been configured and has processed a reading
+    };
+
+    typedef std::function<void(const DeviceState& state)> ScanCallback; // Called for each device by forEachDevice()
+
+  private:
+    // Cold per-device state
+    struct Device
+    {
+      Core core; // Configured when the first reading of the device is released for processing
+      IAQReorderBufferT<IAQSample> reorder; // Only used when reordering is enabled
+    };
+
+    typedef IAQDevicePoolT<DeviceState, Device> Pool;
+
+    // Per-shard state, allocated separately for each shard
+    struct Shard
+    {
+      IAQSampleQueue<IAQSample> queue;
+      std::atomic<uint64_t> submitted; // Readings accepted by the queue, updated by the producers
+      char pad[64]; // Keeps the worker's counter off the producers' cache line
+      std::atomic<uint64_t> processed; // Readings processed by the worker
+      Pool devices; // Only touched by the worker, or while the engine is idle
+      uint64_t late; // Late readings rejected by the reorder buffers, only touched by the worker
+      std::thread worker;
+
+      explicit Shard(size_t capacity) : queue(capacity), submitted(0), processed(0), late(0) {}
+    };
+
+    std::vector<std::unique_ptr<Shard> > shards;
+    int drain_batch; // Maximum number of readings taken from a queue at once
+    std::atomic<bool> stopping; // Set by stop(), after which submit() rejects readings
+    std::atomic<int> producers; // Threads currently inside submit(), which stop() waits for before closing the queues
+    std::atomic<bool> closed; // Set by stop() once no reading can be pushed anymore, telling the workers to finish
+    size_t reorder_capacity = 0; // Reorder buffer size per device, zero when reordering is disabled
+    unsigned long reorder_lateness = 0; // Lateness watermark of the reorder buffers in milliseconds
+    int smoothing_floats = 0; // Donchian smoothing memory per device in the pool slabs, zero for the core's own storage
+    ConfigureCallback configure;
+    ResultCallback result;
+    LateCallback late;
+
+    // Map a device id to its shard
+    Shard& shardFor(uint32_t device) const
+    {
+      uint32_t h = device * 2654435761u; // Fibonacci hashing spreads sequential ids across shards
+      return *shards[(uint32_t)(((uint64_t)h * shards.size()) >> 32)];
+    }
+
+    // Run one reading through the device's IAQ core
+    void process(DeviceState& state, Device& device, const IAQSample& sample)
+    {
+      if (!state.started)
+      {
+        state.started = true;
+        device.core.resetCalibration(sample.timestamp); // Calibration timing starts with the first reading of the device, unless the callback restores a saved state
+        if (configure) configure(sample.device, device.core);
+      }
+      device.core.process(sample.timestamp, sample.temperature, sample.humidity, sample.pressure, sample.gas_resistance);
+      state.timestamp = sample.timestamp;
+#if SE_BME680_ENABLE_IAQ
+      state.IAQ = device.core.IAQ;
+      state.IAQ_accuracy = (uint8_t)device.core.IAQ_accuracy;
+#endif
+      if (result) result(sample, device.core);
+    }
+
+    // Take one reading from the queue on the shard's worker thread, through the device's reorder buffer if enabled
+    void ingest(Shard& shard, const IAQSample& sample)
+    {
+      DeviceState* state = shard.devices.find(sample.device);
+      if (state == nullptr)
+      {
+        state = &shard.devices.add(sample.device);
+        Device& device = shard.devices.cold(*state);
+        if (reorder_capacity > 0) device.reorder.configure(reorder_capacity, reorder_lateness);
+#if SE_BME680_ENABLE_SMOOTHING
+        if (smoothing_floats > 0) device.core.setSmoothingBuffer(shard.devices.extra(*state), smoothing_floats);
+#endif
+      }
+      Device& device = shard.devices.cold(*state);
+      if (reorder_capacity == 0)
+      {
+        process(*state, device, sample);
+        return;
+      }
+      if (!device.reorder.push(sample))
+      {
+        shard.late++;
+        if (late) late(sample);
+        return;
+      }
+      IAQSample ready;
+      while (device.reorder.pop(ready)) process(*state, device, ready);
+    }
+
+    // Release the readings still held in a device's reorder buffer, in timestamp order
+    void release(Shard& shard, DeviceState& state)
+    {
+      Device& device = shard.devices.cold(state);
+      IAQSample ready;
+      while (device.reorder.popAny(ready)) process(state, device, ready);
+    }
+
+    // Release the readings still held in the shard's reorder buffers
+    void release(Shard& shard)
+    {
+      for (size_t i = 0; i < shard.devices.size(); i++) release(shard, shard.devices[i]);
+    }
+
+    // Worker loop: drain the queue in batches, backing off when it is empty
+    void run(Shard* shard)
+    {
+      std::vector<IAQSample> batch(drain_batch);
+      int idle = 0;
+      for (;;)
+      {
+        int n = 0;
+        while (n < drain_batch && shard->queue.pop(batch[n])) n++;
+        if (n == 0)
+        {
+          if (closed.load(std::memory_order_acquire))
+          {
+            // Readings may have been pushed between the empty pop above and the queues being closed, so drain once more. Nothing newer will arrive.
+            while (shard->queue.pop(batch[0]))
+            {
+              ingest(*shard, batch[0]);
+              shard->processed.fetch_add(1, std::memory_order_release);
+            }
+            release(*shard);
+            break;
+          }
+          if (++idle < 64) std::this_thread::yield();
+          else std::this_thread::sleep_for(std::chrono::microseconds(50));
+          continue;
+        }
+        idle = 0;
+        for (int i = 0; i < n; i++) ingest(*shard, batch[i]);
+        shard->processed.fetch_add(n, std::memory_order_release);
+      }
+    }
+
+  public:
+    /*!
+    *  @brief  Start the worker threads
+    *  @param  threads
+    *          Number of worker threads and shards, or zero for the number of hardware threads
+    *  @param  queueCapacity
+    *          Capacity of each shard's ingestion queue, rounded up to a power of 2
+    *  @param  drainBatch
+    *          Maximum number of readings a worker takes from its queue before processing them
+    */
+    explicit IAQEngineT(int threads = 0, int queueCapacity = 16384, int drainBatch = 256) : drain_batch(drainBatch > 0 ? drainBatch : 1), stopping(false), producers(0), closed(false)
+    {
+      if (threads <= 0) threads = (int)std::thread::hardware_concurrency();
+      if (threads <= 0) threads = 1;
+      for (int i = 0; i < threads; i++) shards.emplace_back(new Shard(queueCapacity > 2 ? (size_t)queueCapacity : 2));
+      for (size_t i = 0; i < shards.size(); i++) shards[i]->worker = std::thread(&IAQEngineT::run, this, shards[i].get());
+    }
+
+    // Destructor, which processes the readings still queued before stopping the workers
+    ~IAQEngineT()
+    {
+      stop();
+    }
+
+    IAQEngineT(const IAQEngineT&) = delete;
+    IAQEngineT& operator=(const IAQEngineT&) = delete;
+
+    /*!
+    *  @brief  Set the callback that configures the IAQ core of a new device. Must be set before the first reading is submitted.
+    */
+    void onConfigure(ConfigureCallback callback) { configure = callback; }
+
+    /*!
+    *  @brief  Set the callback that receives each processed reading and the device's IAQ core. Must be set before the first reading is submitted.
+    *          The callback runs on the worker thread of the device's shard, so it must not block for long and must be thread-safe across shards.
+    */
+    void onResult(ResultCallback callback) { result = callback; }
+
+    /*!
+    *  @brief  Set the callback that receives readings rejected as late by the reorder buffers, e.g. to flag them. Without it, late readings are dropped.
+    *          Must be set before the first reading is submitted. The callback runs on a worker thread.
+    */
+    void onLate(LateCallback callback) { late = callback; }
+
+    /*!
+    *  @brief  Put a reorder buffer in front of the IAQ core of every device. Must be called before the first reading is submitted.
+    *  @param  capacity
+    *          Maximum number of readings held per device, or zero to disable reordering
+    *  @param  lateness
+    *          How long, in milliseconds behind the newest timestamp of the device, a reading is held while older readings may still arrive
+    */
+    void setReorderBuffer(size_t capacity, unsigned long lateness)
+    {
+      reorder_capacity = capacity;
+      reorder_lateness = lateness;
+    }
+
+#if SE_BME680_ENABLE_SMOOTHING
+    /*!
+    *  @brief  Keep the Donchian smoothing history of every device in the pool slabs next to its core, instead of a heap block per device.
+    *          The configure callback must then size Donchian smoothing to fit (see IAQCoreT::setSmoothingBuffer()). Must be called before the first
+    *          reading is submitted.
+    *  @param  floats
+    *          Smoothing memory per device in floats, e.g. 3 * periods, or zero for the core's own storage
+    *  @return True if the size was set, false if it is invalid or devices have already been added
+    */
+    bool setSmoothingPool(int floats)
+    {
+      for (size_t i = 0; i < shards.size(); i++)
+      {
+        if (shards[i]->devices.getExtraFloats() != floats && !shards[i]->devices.setExtraFloats(floats)) return false;
+      }
+      smoothing_floats = floats;
+      return true;
+    }
+#endif
+
+    /*!
+    *  @brief  Queue a reading for processing. Safe to call from any number of threads.
+    *  @return True if the reading was queued, false if the shard's queue is full or the engine has been stopped
+    */
+    bool submit(const IAQSample& sample)
+    {
+      // Announce the producer before checking stopping (both sequentially consistent), so stop() either sees this producer or this producer sees stopping
+      producers.fetch_add(1);
+      bool queued = false;
+      if (!stopping.load())
+      {
+        Shard& shard = shardFor(sample.device);
+        queued = shard.queue.push(sample);
+        if (queued) shard.submitted.fetch_add(1, std::memory_order_relaxed);
+      }
+      producers.fetch_sub(1, std::memory_order_release);
+      return queued;
+    }
+
+    /*!
+    *  @brief  Wait until all readings submitted before this call have been taken by the workers. With reordering, readings held in the reorder buffers
+    *          are processed when newer readings of the device arrive, or when the engine is stopped.
+    */
+    void flush(void)
+    {
+      for (size_t i = 0; i < shards.size(); i++)
+      {
+        uint64_t target = shards[i]->submitted.load(std::memory_order_relaxed);
+        while (shards[i]->processed.load(std::memory_order_acquire) < target) std::this_thread::yield();
+      }
+    }
+
+    /*!
+    *  @brief  Process the readings still queued or held for reordering and stop the worker threads. Readings submitted afterwards are rejected.
+    */
+    void stop(void)
+    {
+      if (stopping.exchange(true)) return;
+      while (producers.load() != 0) std::this_thread::yield(); // Readings being pushed right now were accepted, so wait for them to reach the queues
+      closed.store(true, std::memory_order_release);
+      for (size_t i = 0; i < shards.size(); i++)
+      {
+        if (shards[i]->worker.joinable()) shards[i]->worker.join();
+      }
+    }
+
+    // Number of worker threads and shards
+    int getThreadCount(void) const { return (int)shards.size(); }
+
+    // Number of readings taken by the workers so far, including readings held or rejected by the reorder buffers
+    uint64_t getProcessedCount(void) const
+    {
+      uint64_t count = 0;
+      for (size_t i = 0; i < shards.size(); i++) count += shards[i]->processed.load(std::memory_order_acquire);
+      return count;
+    }
+
+    /*!
+    *  @brief  Get the number of devices seen so far. Only valid while no readings are being processed, e.g. after flush() with no concurrent submit().
+    */
+    size_t getDeviceCount(void) const
+    {
+      size_t count = 0;
+      for (size_t i = 0; i < shards.size(); i++) count += shards[i]->devices.size();
+      return count;
+    }
+
+    /*!
+    *  @brief  Get the IAQ core of a device. Only valid while no readings are being processed, e.g. after flush() with no concurrent submit().
+    *  @return The device's IAQ core, or null if no reading of the device has been processed yet
+    */
+    Core* find(uint32_t device)
+    {
+      Shard& shard = shardFor(device);
+      DeviceState* state = shard.devices.find(device);
+      return (state != nullptr && state->started) ? &shard.devices.cold(*state).core : nullptr;
+    }
+
+    /*!
+    *  @brief  Call a function with the hot record of every device. Only reads the dense hot arrays, not the cores.
+    *          Only valid while no readings are being processed, e.g. after flush() with no concurrent submit().
+    */
+    void forEachDevice(ScanCallback callback)
+    {
+      for (size_t i = 0; i < shards.size(); i++)
+      {
+        Pool& devices = shards[i]->devices;
+        for (size_t r = 0; r < devices.size(); r++) callback(devices[r]);
+      }
+    }
+
+    /*!
+    *  @brief  Remove a device and its IAQ core, freeing its slot for the next new device. Readings still held for reordering are processed first,
+    *          on the calling thread. A later reading of the device starts a new core. Only valid while no readings are being processed.
+    *  @return True if the device was removed, false if it is unknown
+    */
+    bool evict(uint32_t device)
+    {
+      Shard& shard = shardFor(device);
+      DeviceState* state = shard.devices.find(device);
+      if (state == nullptr) return false;
+      release(shard, *state);
+      return shard.devices.remove(device);
+    }
+
+    /*!
+    *  @brief  Remove every device whose last processed reading is older than a timestamp, as evict() does. Only valid while no readings are being processed.
+    *  @param  before
+    *          Devices with no processed reading at or after this timestamp, once their held readings are processed, are removed
+    *  @return Number of devices removed
+    */
+    size_t evictIdle(unsigned long before)
+    {
+      size_t count = 0;
+      for (size_t i = 0; i < shards.size(); i++)
+      {
+        Shard& shard = *shards[i];
+        for (size_t r = shard.devices.size(); r-- > 0;) // Backwards, since a removal moves the last record into the removed one's place
+        {
+          DeviceState& state = shard.devices[r];
+          if (state.started && state.timestamp >= before) continue;
+          release(shard, state);
+          if (state.started && state.timestamp >= before) continue; // Held readings made the device current
+          shard.devices.remove(state.device);
+          count++;
+        }
+      }
+      return count;
+    }
+
+    /*!
+    *  @brief  Get the memory held by the device pools, not including heap memory owned by the cores or reorder buffers.
+    *          Only valid while no readings are being processed.
+    *  @return Bytes
+    */
+    size_t getDeviceMemory(void) const
+    {
+      size_t bytes = 0;
+      for (size_t i = 0; i < shards.size(); i++) bytes += shards[i]->devices.getMemoryUsage();
+      return bytes;
+    }
+
+    /*!
+    *  @brief  Get the number of readings rejected as late by the reorder buffers. Only valid while no readings are being processed.
+    */
+    uint64_t getLateCount(void) const
+    {
+      uint64_t count = 0;
+      for (size_t i = 0; i < shards.size(); i++) count += shards[i]->late;
+      return count;
+    }
+};
+
+// Multi-threaded IAQ engine with the default policy
+typedef IAQEngineT<> IAQEngine;
+
+#endif
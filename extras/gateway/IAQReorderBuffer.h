@@ -0,0 +1,113 @@
+/**
+ * @file  IAQReorderBuffer.h
+ * @brief Per-device reorder buffer for readings that arrive late or out of order over lossy links, placed in front of the IAQ processing.
+ *        Readings are held in a bounded min-heap by timestamp (O(log k) insert and release for k held readings) and released in timestamp order once
+ *        they are older than the newest timestamp seen minus the lateness watermark, or when the buffer is full. A reading that arrives after a newer
+ *        one has already been released is late: feeding it to the IAQ core would run the calibration timers and smoothing windows backwards, so it
+ *        is rejected for the caller to drop or flag.
+ *
+ *        Host only (uses the C++ standard library).
+ */
+
+#ifndef __IAQ_REORDER_BUFFER_H__
+#define __IAQ_REORDER_BUFFER_H__
+
+#include <stdint.h>
+#include <algorithm>
+#include <vector>
+
+/*!
+*  @brief  Bounded reorder buffer for the readings of one device
+*  @tparam Sample
+*          Reading type with an unsigned long timestamp member, e.g. IAQSample
+*/
+template <class Sample>
+class IAQReorderBufferT
+{
+  private:
+    // Heap order: the oldest timestamp at the front
+    struct Later
+    {
+      bool operator()(const Sample& a, const Sample& b) const { return a.timestamp > b.timestamp; }
+    };
+
+    std::vector<Sample> heap; // Held readings
+    size_t capacity = 16; // Maximum number of held readings
+    unsigned long lateness = 0; // Lateness watermark in milliseconds
+    unsigned long newest = 0; // Newest timestamp seen
+    unsigned long released = 0; // Timestamp of the last released reading
+    bool seen = false; // Whether any reading has been accepted
+    bool any_released = false; // Whether any reading has been released
+    uint32_t late_count = 0; // Number of rejected late readings
+
+  public:
+    // Constructor, which allocates nothing, so idle buffers (e.g. one per pooled device with reordering disabled) cost no heap memory.
+    // Memory is reserved by configure(), or grows with the first readings held.
+    IAQReorderBufferT(size_t capacity = 16, unsigned long lateness = 10000) : capacity(capacity > 0 ? capacity : 1), lateness(lateness) {}
+
+    /*!
+    *  @brief  Set the buffer size and the lateness watermark, and reserve memory for a full buffer. Held readings are kept.
+    *  @param  capacity
+    *          Maximum number of held readings (at least 1). A full buffer releases its oldest reading regardless of the watermark.
+    *  @param  lateness
+    *          How long, in milliseconds behind the newest timestamp seen, a reading is held while older readings may still arrive
+    */
+    void configure(size_t capacity, unsigned long lateness)
+    {
+      this->capacity = capacity > 0 ? capacity : 1;
+      this->lateness = lateness;
+      heap.reserve(this->capacity + 1);
+    }
+
+    /*!
+    *  @brief  Add a reading. Call pop() afterwards until it returns false to release the readings that became ready.
+    *  @return True if the reading was accepted, false if it is late (not newer than a reading already released, which includes duplicates)
+    */
+    bool push(const Sample& sample)
+    {
+      if (any_released && sample.timestamp <= released)
+      {
+        late_count++;
+        return false;
+      }
+      heap.push_back(sample);
+      std::push_heap(heap.begin(), heap.end(), Later());
+      if (!seen || sample.timestamp > newest) newest = sample.timestamp;
+      seen = true;
+      return true;
+    }
+
+    /*!
+    *  @brief  Release the oldest held reading if it has passed the lateness watermark or the buffer is over capacity
+    *  @return True if a reading was released into sample
+    */
+    bool pop(Sample& sample)
+    {
+      if (heap.empty()) return false;
+      if (heap.size() <= capacity && newest - heap.front().timestamp < lateness) return false; // Still within the watermark
+      return popAny(sample);
+    }
+
+    /*!
+    *  @brief  Release the oldest held reading regardless of the watermark, e.g. when the device goes offline or the gateway shuts down
+    *  @return True if a reading was released into sample
+    */
+    bool popAny(Sample& sample)
+    {
+      if (heap.empty()) return false;
+      std::pop_heap(heap.begin(), heap.end(), Later());
+      sample = heap.back();
+      heap.pop_back();
+      released = sample.timestamp;
+      any_released = true;
+      return true;
+    }
+
+    // Number of held readings
+    size_t size(void) const { return heap.size(); }
+
+    // Number of late readings rejected so far
+    uint32_t getLateCount(void) const { return late_count; }
+};
+
+#endif
@@ -0,0 +1,277 @@
+/**
+ * @file  IAQStateStore.h
+ * @brief Persistent calibration states for a fleet of sensors in one memory-mapped file with a fixed record per device, keyed by device id.
+ *        Records are located by open addressing on the device id directly in the mapped file, and IAQ cores restore from and save to the mapped
+ *        records in place, so a restarted gateway resumes every device's calibration without reading or parsing the file first.
+ *
+ *        Each record holds two slots of IAQCoreT::State. A save always writes the slot that is not the current one, with a sequence number and a
+ *        checksum, and restore uses the newest slot whose checksum matches. A crash or power loss during a save therefore loses at most that save.
+ *        Writes reach the file when the kernel writes back the mapped pages, which survives a crash of the gateway process. Call sync() to also
+ *        survive power loss up to that point.
+ *
+ *        The file layout depends on the State layout (library configuration, policy and compiler), which is checked when the file is opened.
+ *        Host only (POSIX mmap). Include with -I pointing at the library's src directory.
+ */
+
+#ifndef __IAQ_STATE_STORE_H__
+#define __IAQ_STATE_STORE_H__
+
+#include <IAQCore.h>
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*!
+*  @brief  Memory-mapped store of calibration states, one fixed record per device
+*  @tparam Core
+*          IAQ core type whose State is stored, IAQCore or an IAQCoreT with a custom policy
+*/
+template <class Core = IAQCore>
+class IAQStateStoreT
+{
+  public:
+    typedef typename Core::State State;
+
+  private:
+    static const uint32_t VERSION = 1;
+
+    // File header, written once when the file is created
+    struct Header
+    {
+      char magic[8]; // "IAQSTATE", written last so a partially created file is never accepted
+      uint32_t version;
+      uint32_t record_size; // sizeof(Record)
+      uint32_t state_size; // sizeof(State)
+      uint32_t table_size; // Number of records, a power of 2
+      uint64_t reserved[5];
+    };
+
+    // One copy of a device's state
+    struct Slot
+    {
+      uint64_t sequence; // Increases with every save of the device, zero when the slot is empty or known to be invalid
+      uint64_t checksum; // Checksum over the sequence number and the state
+      State state;
+    };
+
+    // One device
+    struct Record
+    {
+      std::atomic<uint64_t> key; // Device id + 1, or zero when the record is free. Claimed atomically, so different devices can be saved from different threads.
+      uint64_t reserved;
+      Slot slot[2];
+    };
+
+    int fd = -1; // File descriptor of the open store
+    void* map = nullptr; // Mapped file
+    size_t map_size = 0; // Size of the mapping in bytes
+    Record* records = nullptr; // Record table following the header
+    uint32_t mask = 0; // Table size - 1
+
+    // 64-bit FNV-1a checksum over the sequence number and the state
+    static uint64_t checksum(uint64_t sequence, const State& state)
+    {
+      uint64_t h = 14695981039346656037ULL;
+      const uint8_t* p = reinterpret_cast<const uint8_t*>(&sequence);
+      for (size_t i = 0; i < sizeof(sequence); i++) h = (h ^ p[i]) * 1099511628211ULL;
+      p = reinterpret_cast<const uint8_t*>(&state);
+      for (size_t i = 0; i < sizeof(State); i++) h = (h ^ p[i]) * 1099511628211ULL;
+      return h;
+    }
+
+    // Whether a slot holds a complete save
+    static bool valid(const Slot& slot)
+    {
+      return slot.sequence != 0 && slot.checksum == checksum(slot.sequence, slot.state);
+    }
+
+    // Find the record of a device by linear probing, optionally claiming a free record for it
+    Record* find(uint32_t device, bool claim)
+    {
+      if (records == nullptr) return nullptr;
+      uint64_t key = (uint64_t)device + 1;
+      uint32_t i = (device * 2654435761u) & mask;
+      for (uint32_t probe = 0; probe <= mask; probe++, i = (i + 1) & mask)
+      {
+        uint64_t current = records[i].key.load(std::memory_order_acquire);
+        if (current == key) return &records[i];
+        if (current == 0)
+        {
+          if (!claim) return nullptr; // Records are never freed, so the device has no record
+          if (records[i].key.compare_exchange_strong(current, key, std::memory_order_acq_rel)) return &records[i];
+          if (current == key) return &records[i]; // Claimed by another thread for the same device
+        }
+      }
+      return nullptr; // Table is full
+    }
+
+    // Close after a failed open
+    bool fail(void)
+    {
+      close();
+      return false;
+    }
+
+  public:
+    IAQStateStoreT() {}
+
+    // Destructor, which unmaps and closes the file without forcing a write-back
+    ~IAQStateStoreT()
+    {
+      close();
+    }
+
+    IAQStateStoreT(const IAQStateStoreT&) = delete;
+    IAQStateStoreT& operator=(const IAQStateStoreT&) = delete;
+
+    /*!
+    *  @brief  Open a store file, creating it if it does not exist
+    *  @param  path
+    *          Path of the store file
+    *  @param  capacity
+    *          Maximum number of devices when the file is created (the table is sized for a load factor of at most 75%). Ignored for existing files.
+    *          A file whose header is blank, because the process crashed while creating it, is initialized again.
+    *  @return True if the store is open, false if the file could not be created or mapped, or was written with a different record layout
+    */
+    bool open(const char* path, uint32_t capacity)
+    {
+      close();
+      fd = ::open(path, O_RDWR | O_CREAT, 0644);
+      if (fd < 0) return false;
+      struct stat st;
+      if (fstat(fd, &st) != 0) return fail();
+
+      Header header;
+      bool created = st.st_size == 0;
+      if (!created)
+      {
+        if ((size_t)st.st_size < sizeof(Header) || pread(fd, &header, sizeof(header), 0) != (ssize_t)sizeof(header)) return fail();
+        static const char blank[8] = {};
+        created = memcmp(header.magic, blank, 8) == 0; // The creation crashed before the header was written, so no record was written either
+      }
+      if (created)
+      {
+        uint32_t size = 2;
+        while (size < capacity + capacity / 3 && size < 0x80000000u) size <<= 1;
+        memset(&header, 0, sizeof(header));
+        header.version = VERSION;
+        header.record_size = sizeof(Record);
+        header.state_size = sizeof(State);
+        header.table_size = size;
+        map_size = sizeof(Header) + (size_t)size * sizeof(Record);
+        if (ftruncate(fd, 0) != 0 || ftruncate(fd, (off_t)map_size) != 0) return fail(); // New pages read as zero, so every record starts free
+      }
+      else
+      {
+        if (memcmp(header.magic, "IAQSTATE", 8) != 0 || header.version != VERSION || header.record_size != sizeof(Record) || header.state_size != sizeof(State)) return fail();
+        if (header.table_size < 2 || (header.table_size & (header.table_size - 1)) != 0) return fail();
+        map_size = sizeof(Header) + (size_t)header.table_size * sizeof(Record);
+        if ((size_t)st.st_size < map_size) return fail();
+      }
+
+      map = mmap(nullptr, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+      if (map == MAP_FAILED)
+      {
+        map = nullptr;
+        return fail();
+      }
+      if (created)
+      {
+        memcpy(map, &header, sizeof(header));
+        memcpy(map, "IAQSTATE", 8);
+        msync(map, sizeof(Header), MS_SYNC); // Make the header durable before any record is written
+      }
+      records = reinterpret_cast<Record*>(static_cast<char*>(map) + sizeof(Header));
+      mask = header.table_size - 1;
+      return true;
+    }
+
+    /*!
+    *  @brief  Unmap and close the store file. Saved states stay in the file, and write-back is left to the kernel unless sync() was called.
+    */
+    void close(void)
+    {
+      if (map != nullptr) munmap(map, map_size);
+      if (fd >= 0) ::close(fd);
+      map = nullptr;
+      map_size = 0;
+      records = nullptr;
+      mask = 0;
+      fd = -1;
+    }
+
+    // Whether a store file is open
+    bool isOpen(void) const { return records != nullptr; }
+
+    /*!
+    *  @brief  Restore a device's IAQ core from its newest complete save. Configure the core before restoring, see IAQCoreT::restoreState().
+    *          Not safe to call concurrently with save() for the same device.
+    *  @return True if the core was restored, false if the device has no complete save
+    */
+    bool restore(uint32_t device, Core& core)
+    {
+      Record* record = find(device, false);
+      if (record == nullptr) return false;
+      bool valid0 = valid(record->slot[0]), valid1 = valid(record->slot[1]);
+      if (!valid0 && !valid1) return false;
+      int newest = (valid0 && (!valid1 || record->slot[0].sequence > record->slot[1].sequence)) ? 0 : 1;
+      core.restoreState(record->slot[newest].state);
+      return true;
+    }
+
+    /*!
+    *  @brief  Save a device's IAQ core into the slot of its record that does not hold the newest complete save, claiming a record on the first save.
+    *          Saves of different devices may run concurrently. Saves of one device must not.
+    *  @return True if the state was saved, false if the store is not open or is full
+    */
+    bool save(uint32_t device, Core& core)
+    {
+      Record* record = find(device, true);
+      if (record == nullptr) return false;
+      // Write over a slot that does not hold a complete save first, otherwise over the older one. Only complete saves count for the sequence,
+      // because a torn slot can carry any sequence number.
+      bool valid0 = valid(record->slot[0]), valid1 = valid(record->slot[1]);
+      uint64_t sequence0 = valid0 ? record->slot[0].sequence : 0, sequence1 = valid1 ? record->slot[1].sequence : 0;
+      Slot& slot = record->slot[(!valid0 || (valid1 && sequence0 <= sequence1)) ? 0 : 1];
+      uint64_t sequence = (sequence0 > sequence1 ? sequence0 : sequence1) + 1;
+      slot.sequence = 0; // Invalidate the slot while it is being written
+      std::atomic_thread_fence(std::memory_order_release);
+      core.saveState(slot.state);
+      slot.checksum = checksum(sequence, slot.state);
+      std::atomic_thread_fence(std::memory_order_release);
+      slot.sequence = sequence; // Commit
+      return true;
+    }
+
+    /*!
+    *  @brief  Write all saved states back to the file and wait for the device, so they survive a power loss
+    *  @return True if the write-back succeeded
+    */
+    bool sync(void)
+    {
+      return map != nullptr && msync(map, map_size, MS_SYNC) == 0;
+    }
+
+    // Number of devices with a record
+    uint32_t getDeviceCount(void) const
+    {
+      uint32_t count = 0;
+      if (records != nullptr)
+      {
+        for (uint32_t i = 0; i <= mask; i++) if (records[i].key.load(std::memory_order_relaxed) != 0) count++;
+      }
+      return count;
+    }
+
+    // Number of records in the file, which is the hard limit on the number of devices
+    uint32_t getCapacity(void) const { return records != nullptr ? mask + 1 : 0; }
+};
+
+// State store for cores with the default policy
+typedef IAQStateStoreT<> IAQStateStore;
+
+#endif
@@ -0,0 +1,453 @@
+/**
+ * @file  gateway_check.cpp
+ * @brief Host-side consistency checks for the gateway extras, to run after changes to IAQCore or its policies:
+ *          batch    IAQBatch against one IAQCore per sensor, without smoothing, with Donchian smoothing and with exponential smoothing (with range
+ *                   limits), including gas readings above the calibration limit and ticks where some sensors have no reading. Every output must
+ *                   be bit-identical.
+ *          engine   IAQEngine with several producers and worker threads: every device must see its readings in submission order, end in the
+ *                   same state as an IAQCore fed sequentially, and stop() must process every reading submit() accepted.
+ *          store    IAQStateStore: a state restored after reopening the file must continue exactly like the saved core, a torn newest slot
+ *                   must fall back to the previous save (also when the torn slot carries the highest sequence number and is saved over), and a
+ *                   file with a blank header must be initialized again.
+ *          fusion   SensorFusionT with simulated sensors: a sensor that always fails to read must be excluded, and included again once it reads
+ *                   in agreement with the others. A sensor reporting NaN must not affect the fused reading and must be excluded.
+ *
+ *        Build:  g++ -O2 -pthread -I../../src -I../gateway gateway_check.cpp -o gateway_check
+ *        Usage:  ./gateway_check
+ *
+ *        Prints one line per check and exits with a nonzero status if any check fails. Compare with the same compiler flags the gateway is built
+ *        with, since floating point contraction can differ between builds.
+ */
+
+#include <IAQBatch.h>
+#include <IAQEngine.h>
+#include <IAQStateStore.h>
+#include <SensorFusion.h>
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+static const unsigned long interval = 3000; // Simulated reading interval in milliseconds
+static int failures = 0;
+
+// Report one check
+static void report(const char* name, bool passed, const char* detail)
+{
+  printf("%-40s %s  %s\n", name, passed ? "PASS" : "FAIL", detail);
+  if (!passed) failures++;
+}
+
+// Whether two floats are bit-identical (NaN compares equal to itself)
+static bool same(float a, float b)
+{
+  return memcmp(&a, &b, sizeof(float)) == 0;
+}
+
+// Noise hash of a device and a tick
+static uint32_t hash(uint32_t device, long k)
+{
+  uint32_t x = device * 2654435761u + 12345u;
+  x ^= (uint32_t)k * 2246822519u;
+  x ^= x >> 15;
+  x *= 2654435761u;
+  x ^= x >> 13;
+  return x;
+}
+
+// Reading k of a device: slow cycles, noise, and occasional gas readings above the default upper gas resistance limit, which the core rejects
+static IAQSample reading(uint32_t device, long k)
+{
+  uint32_t x = hash(device, k);
+  float noise = (float)(x % 1000) / 1000.0F - 0.5F;
+  float phase = (float)(device % 97) * 0.1F;
+  IAQSample s;
+  s.device = device;
+  s.timestamp = (unsigned long)k * interval;
+  s.temperature = 21.0F + 3.0F * sinf(0.01F * (float)k + phase) + 0.3F * noise;
+  s.humidity = 40.0F + 8.0F * cosf(0.013F * (float)k + phase) + noise;
+  s.pressure = 101325.0F;
+  s.gas_resistance = (x % 200 == 0) ? 400000 : (uint32_t)(60000.0F + 500.0F * (float)(device % 40) + 20000.0F * sinf(0.002F * (float)k + phase) + 3000.0F * noise);
+  return s;
+}
+
+// Shared configuration of the cores under test. Mode 0: no smoothing, 1: Donchian, 2: exponential.
+static void configure(IAQCore& core, int mode)
+{
+  core.setGasCalibrationTimings(1000, 2000, 62000); // Minimums, so calibration reaches every stage within the checks
+  if (mode == 1) core.setDonchianSmoothing(true, 50, 1.0F, 5.0F, 20000.0F);
+  if (mode == 2) core.setExponentialSmoothing(true, 50, 5, 1.0F, 5.0F, 20000.0F);
+}
+
+// IAQBatch against one IAQCore per sensor
+static void checkBatch(int mode)
+{
+  const int sensors = 32;
+  const long ticks = 20000;
+  IAQBatch batch(sensors);
+  batch.setGasCalibrationTimings(1000, 2000, 62000);
+  if (mode == 1) batch.setDonchianSmoothing(true, 50, 1.0F, 5.0F, 20000.0F);
+  if (mode == 2) batch.setExponentialSmoothing(true, 50, 5, 1.0F, 5.0F, 20000.0F);
+  std::vector<IAQCore> cores(sensors);
+  for (int s = 0; s < sensors; s++)
+  {
+    configure(cores[s], mode);
+    cores[s].resetCalibration(0); // The batch starts gas calibration at timestamp zero
+  }
+
+  std::vector<float> temperature(sensors), humidity(sensors);
+  std::vector<uint32_t> gas(sensors);
+  std::vector<uint8_t> valid(sensors);
+  long compared = 0, mismatches = 0;
+  int accuracy = 0;
+  for (long k = 1; k <= ticks; k++)
+  {
+    for (int s = 0; s < sensors; s++)
+    {
+      IAQSample r = reading((uint32_t)s, k);
+      temperature[s] = r.temperature;
+      humidity[s] = r.humidity;
+      gas[s] = r.gas_resistance;
+      valid[s] = hash((uint32_t)s, -k) % 10 != 0; // About one sensor in ten misses each tick
+    }
+    unsigned long now = (unsigned long)k * interval;
+    batch.process(now, temperature.data(), humidity.data(), gas.data(), valid.data());
+    for (int s = 0; s < sensors; s++)
+    {
+      if (!valid[s]) continue;
+      IAQCore& core = cores[s];
+      core.process(now, temperature[s], humidity[s], 101325.0F, gas[s]);
+      compared++;
+      if (!same(batch.temperature_compensated[s], core.getCompensatedTemperature()) || !same(batch.humidity_compensated[s], core.getCompensatedHumidity()) ||
+          !same(batch.IAQ[s], core.getIAQ()) || batch.IAQ_accuracy[s] != core.getIAQAccuracy())
+      {
+        mismatches++;
+      }
+#if SE_BME680_ENABLE_DEW_POINT
+      else if (!same(batch.dew_point[s], core.getDewPoint()))
+      {
+        mismatches++;
+      }
+#endif
+      if (core.getIAQAccuracy() > accuracy) accuracy = core.getIAQAccuracy();
+    }
+  }
+
+  static const char* names[] = { "batch vs core, no smoothing", "batch vs core, Donchian smoothing", "batch vs core, exponential smoothing" };
+  char detail[128];
+  snprintf(detail, sizeof(detail), "%ld readings, %ld mismatches, highest accuracy %d", compared, mismatches, accuracy);
+  report(names[mode], mismatches == 0 && accuracy >= 3, detail);
+}
+
+// Per-device order, equivalence with a sequential core, and stop() accounting of IAQEngine
+static void checkEngine(int threads)
+{
+  const int devices = 400, producers = 4;
+  const long readings = 600;
+
+  // Sequential reference
+  std::vector<IAQCore> reference(devices);
+  for (int d = 0; d < devices; d++)
+  {
+    configure(reference[d], 1);
+    reference[d].resetCalibration(reading((uint32_t)d, 0).timestamp);
+    for (long k = 0; k < readings; k++)
+    {
+      IAQSample s = reading((uint32_t)d, k);
+      reference[d].process(s.timestamp, s.temperature, s.humidity, s.pressure, s.gas_resistance);
+    }
+  }
+
+  IAQEngine engine(threads, 1024, 64);
+  engine.onConfigure([](uint32_t, IAQCore& core) { configure(core, 1); });
+  std::vector<long> next(devices, 0); // Next expected reading of each device, only touched by the device's worker
+  std::atomic<long> outOfOrder(0);
+  engine.onResult([&](const IAQSample& sample, IAQCore&)
+  {
+    long k = (long)(sample.timestamp / interval);
+    if (k != next[sample.device]) outOfOrder++;
+    next[sample.device] = k + 1;
+  });
+
+  // Each producer submits the readings of its own devices in order, interleaved with the other producers
+  std::vector<std::thread> producerThreads;
+  for (int p = 0; p < producers; p++)
+  {
+    producerThreads.emplace_back([&, p]()
+    {
+      for (long k = 0; k < readings; k++)
+      {
+        for (int d = p; d < devices; d += producers)
+        {
+          while (!engine.submit(reading((uint32_t)d, k))) std::this_thread::yield(); // Queue full, wait for the workers
+        }
+      }
+    });
+  }
+  for (size_t p = 0; p < producerThreads.size(); p++) producerThreads[p].join();
+  engine.flush();
+
+  long mismatches = 0;
+  for (int d = 0; d < devices; d++)
+  {
+    IAQCore* core = engine.find((uint32_t)d);
+    if (core == nullptr || !same(core->getIAQ(), reference[d].getIAQ()) || core->getIAQAccuracy() != reference[d].getIAQAccuracy() ||
+        core->getGasCalibrationStage() != reference[d].getGasCalibrationStage() || next[d] != readings)
+    {
+      mismatches++;
+    }
+  }
+  char detail[128];
+  snprintf(detail, sizeof(detail), "%d devices, %ld out of order, %ld mismatches", devices, outOfOrder.load(), mismatches);
+  char name[64];
+  snprintf(name, sizeof(name), "engine order and state, %d threads", threads);
+  report(name, outOfOrder.load() == 0 && mismatches == 0, detail);
+
+  // Producers racing stop(): every reading submit() accepted must be processed
+  IAQEngine stopping(threads, 1 << 16);
+  std::atomic<uint64_t> stopAccepted(0);
+  producerThreads.clear();
+  for (int p = 0; p < producers; p++)
+  {
+    producerThreads.emplace_back([&, p]()
+    {
+      for (long k = 0;; k++)
+      {
+        if (stopping.submit(reading((uint32_t)(p * 1000 + k % 50), k))) stopAccepted++;
+        else if (k > 1000) break; // Stopped, or the queue stayed full
+      }
+    });
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  stopping.stop();
+  for (size_t p = 0; p < producerThreads.size(); p++) producerThreads[p].join();
+  snprintf(detail, sizeof(detail), "%llu accepted, %llu processed", (unsigned long long)stopAccepted.load(), (unsigned long long)stopping.getProcessedCount());
+  snprintf(name, sizeof(name), "engine stop with producers, %d threads", threads);
+  report(name, stopping.getProcessedCount() == stopAccepted.load(), detail);
+}
+
+// Layout of a state store record, mirroring IAQStateStoreT, to tear a slot in the file
+struct StoreSlot
+{
+  uint64_t sequence;
+  uint64_t checksum;
+  IAQCore::State state;
+};
+struct StoreRecord
+{
+  uint64_t key;
+  uint64_t reserved;
+  StoreSlot slot[2];
+};
+static const size_t storeHeaderSize = 64;
+
+// Tear the newest slot of a device in a closed store file, as a crash during its save would. A nonzero sequence is written into the torn slot,
+// as when the page holding the sequence reached the disk but the page holding the state did not.
+static bool tearNewest(const char* path, uint32_t device, uint64_t sequence)
+{
+  FILE* f = fopen(path, "r+b");
+  if (f == nullptr) return false;
+  uint32_t recordSize = 0; // Header field after the magic and the version
+  bool torn = false;
+  if (fseek(f, 12, SEEK_SET) == 0 && fread(&recordSize, sizeof(recordSize), 1, f) == 1 && recordSize == sizeof(StoreRecord)) // Otherwise the mirrored layout is out of date
+  {
+    StoreRecord record;
+    for (long offset = (long)storeHeaderSize; fseek(f, offset, SEEK_SET) == 0 && fread(&record, sizeof(record), 1, f) == 1; offset += (long)sizeof(record))
+    {
+      if (record.key != device + 1) continue;
+      int newest = record.slot[0].sequence > record.slot[1].sequence ? 0 : 1;
+      reinterpret_cast<uint8_t*>(&record.slot[newest].state)[sizeof(IAQCore::State) / 2] ^= 0x5A; // Half-written state: the checksum no longer matches
+      if (sequence != 0) record.slot[newest].sequence = sequence;
+      torn = fseek(f, offset, SEEK_SET) == 0 && fwrite(&record, sizeof(record), 1, f) == 1;
+      break;
+    }
+  }
+  fclose(f);
+  return torn;
+}
+
+// Feed readings [first, last) of a device to a core
+static void feed(IAQCore& core, uint32_t device, long first, long last)
+{
+  for (long k = first; k < last; k++)
+  {
+    IAQSample s = reading(device, k);
+    core.process(s.timestamp, s.temperature, s.humidity, s.pressure, s.gas_resistance);
+  }
+}
+
+// A core configured for the store check and fed readings [0, last) of a device
+static void prepare(IAQCore& core, int mode, uint32_t device, long last)
+{
+  configure(core, mode);
+  core.resetCalibration(0);
+  feed(core, device, 0, last);
+}
+
+// Whether a restored core produces the same outputs for further readings as a core that was fed readings [0, last) of the device directly
+static bool continuesLike(IAQCore& restored, int mode, uint32_t device, long last)
+{
+  IAQCore reference;
+  prepare(reference, mode, device, last);
+  for (long k = last; k < last + 2000; k++)
+  {
+    feed(restored, device, k, k + 1);
+    feed(reference, device, k, k + 1);
+    if (!same(restored.getIAQ(), reference.getIAQ()) || restored.getIAQAccuracy() != reference.getIAQAccuracy()) return false;
+  }
+  return true;
+}
+
+// Save and restore through IAQStateStore, including torn saves and a file whose creation crashed
+static void checkStore(int mode)
+{
+  char path[] = "/tmp/gateway_check_XXXXXX";
+  int fd = mkstemp(path);
+  if (fd < 0)
+  {
+    report("state store", false, "cannot create a temporary file");
+    return;
+  }
+  close(fd);
+
+  const int devices = 50;
+  const long first = 3000, second = 3100; // Readings before the first and the second save
+  bool saved = true;
+  {
+    IAQStateStore store;
+    saved = store.open(path, devices);
+    for (int d = 0; d < devices && saved; d++)
+    {
+      IAQCore core;
+      prepare(core, mode, (uint32_t)d, first);
+      saved = store.save((uint32_t)d, core);
+      feed(core, (uint32_t)d, first, second);
+      saved = saved && store.save((uint32_t)d, core);
+    }
+  }
+
+  // Restore every device after reopening, then tear the newest slot of device 7 as a crash during its save would
+  long mismatches = 0;
+  bool fellBack = false;
+  if (saved)
+  {
+    IAQStateStore store;
+    saved = store.open(path, 1);
+    for (int d = 0; d < devices && saved; d++)
+    {
+      IAQCore core;
+      configure(core, mode);
+      if (!store.restore((uint32_t)d, core) || !continuesLike(core, mode, (uint32_t)d, second)) mismatches++;
+    }
+    store.close();
+
+    IAQCore torn;
+    configure(torn, mode);
+    fellBack = tearNewest(path, 7, 0) && store.open(path, 1) && store.restore(7, torn) && continuesLike(torn, mode, 7, first);
+    store.close();
+
+    // A torn slot with the highest sequence must not make the next save overwrite the only good slot. Save over it and tear that save as well:
+    // the first save must still be there.
+    IAQCore later, restored;
+    prepare(later, mode, 8, second);
+    configure(restored, mode);
+    fellBack = fellBack && tearNewest(path, 8, 1000) && store.open(path, 1) && store.save(8, later);
+    store.close();
+    fellBack = fellBack && tearNewest(path, 8, 0) && store.open(path, 1) && store.restore(8, restored) && continuesLike(restored, mode, 8, first);
+    store.close();
+  }
+
+  // A file whose header was never written (a crash while it was created) is initialized again rather than rejected
+  fd = open(path, O_RDWR | O_TRUNC);
+  bool reinitialized = fd >= 0 && ftruncate(fd, 4096) == 0;
+  if (fd >= 0) close(fd);
+  {
+    IAQStateStore store;
+    IAQCore core;
+    configure(core, mode);
+    reinitialized = reinitialized && store.open(path, devices) && store.getCapacity() >= (uint32_t)devices && store.save(0, core);
+  }
+  unlink(path);
+
+  char detail[128];
+  snprintf(detail, sizeof(detail), "%d devices, %ld mismatches, torn slots %s, blank file %s", devices, mismatches, fellBack ? "fell back" : "did not fall back",
+           reinitialized ? "initialized" : "rejected");
+  report(mode == 2 ? "state store, exponential smoothing" : "state store, no smoothing", saved && mismatches == 0 && fellBack && reinitialized, detail);
+}
+
+// Simulated sensor with the reading interface of SE_BME680
+struct SimulatedSensor
+{
+  bool working = true; // Whether endReading() succeeds
+  float temperature = 21.0F, humidity = 40.0F, iaq = 80.0F;
+
+  bool beginReading(void) { return true; }
+  bool endReading(void) { return working; }
+  float getCompensatedTemperature(void) { return temperature; }
+  float getCompensatedHumidity(void) { return humidity; }
+  float getIAQ(void) { return iaq; }
+  int getIAQAccuracy(void) { return 3; }
+};
+
+// Exclusion of a sensor that keeps failing or reports NaN, and its recovery
+static void checkFusion(void)
+{
+  SimulatedSensor sensors[4];
+  SensorFusionT<SimulatedSensor> fusion;
+  for (int i = 0; i < 4; i++) fusion.addSensor(&sensors[i]);
+  sensors[3].working = false;
+  int excludedAfter = 0;
+  for (int cycle = 1; cycle <= 100 && excludedAfter == 0; cycle++)
+  {
+    for (int i = 0; i < 3; i++) sensors[i].temperature = 21.0F + 0.1F * (float)i;
+    fusion.performReading();
+    if (fusion.isExcluded(3)) excludedAfter = cycle;
+  }
+  bool othersIncluded = !fusion.isExcluded(0) && !fusion.isExcluded(1) && !fusion.isExcluded(2);
+
+  sensors[3].working = true;
+  int includedAfter = 0;
+  for (int cycle = 1; cycle <= 200 && includedAfter == 0; cycle++)
+  {
+    fusion.performReading();
+    if (!fusion.isExcluded(3)) includedAfter = cycle;
+  }
+
+  char detail[128];
+  snprintf(detail, sizeof(detail), "excluded after %d failed cycles, included again after %d good cycles", excludedAfter, includedAfter);
+  report("fusion of a failing sensor", excludedAfter > 0 && othersIncluded && includedAfter > 0, detail);
+
+  // A sensor that reads successfully but reports NaN must not reach the median, and is treated like a failing sensor
+  SimulatedSensor nanSensors[4];
+  SensorFusionT<SimulatedSensor> nanFusion;
+  for (int i = 0; i < 4; i++) nanFusion.addSensor(&nanSensors[i]);
+  nanSensors[3].temperature = NAN;
+  bool finite = true;
+  excludedAfter = 0;
+  for (int cycle = 1; cycle <= 100; cycle++)
+  {
+    for (int i = 0; i < 3; i++) nanSensors[i].temperature = 21.0F + 0.1F * (float)i;
+    nanFusion.performReading();
+    if (!(fabs(nanFusion.temperature_compensated - 21.1F) < 0.01F)) finite = false;
+    if (excludedAfter == 0 && nanFusion.isExcluded(3)) excludedAfter = cycle;
+  }
+  snprintf(detail, sizeof(detail), "fused temperature %s, excluded after %d cycles", finite ? "unaffected" : "CORRUPTED", excludedAfter);
+  report("fusion of a sensor reporting NaN", finite && excludedAfter > 0, detail);
+}
+
+int main(void)
+{
+  for (int mode = 0; mode < 3; mode++) checkBatch(mode);
+  checkEngine(1);
+  checkEngine(4);
+  checkStore(0);
+  checkStore(2);
+  checkFusion();
+  printf("%s\n", failures == 0 ? "All checks passed" : "Some checks FAILED");
+  return failures == 0 ? 0 : 1;
+}
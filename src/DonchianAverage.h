@@ -2,45 +2,267 @@
  * @file  DonchianAverage.h
  * @brief Helper class to smooth sensor measurements using a circular buffer to track an average value based on the min/max range over a specified number of samples.
  *        This is useful for removing oscillations in sensor readings due to the cycling of air conditioners, heaters, etc.
+ *
+ *        The data points are stored through a storage codec. DonchianAverage stores floats. For long histories, the 16-bit codecs halve the memory:
+ *          DonchianLinearStorage: fixed point with an offset and scale, error at most half a step, e.g. ±0.001°C over -40°C to 85°C, ±0.0008% over 0-100% RH
+ *          DonchianLogStorage:    fixed point logarithm, relative error at most half a step, e.g. ±0.012% over 10 ohms to 100M ohms
+ *        Both codecs are monotonic, so the min/max search runs on the 16-bit codes and only decodes a value when it becomes the new min or max.
+ *        Values outside the codec range are clamped to it. When a range limit clips the channel, the clipped side inherits the absolute error of the other side.
  * @link  https://www.investopedia.com/terms/d/donchianchannels.asp
  */
 
 #ifndef __DONCHIAN_AVERAGE_H__
 #define __DONCHIAN_AVERAGE_H__
 
-class DonchianAverage
+#include <math.h>
+#include <stdint.h>
+
+// Full precision storage, 4 bytes per data point
+class DonchianFloatStorage
+{
+  public:
+    typedef float Sample;
+    Sample encode(float x) const { return x; }
+    float decode(Sample s) const { return s; }
+};
+
+// Linear 16-bit fixed point storage, 2 bytes per data point. The error is at most half a step, i.e. (high - low) / 131070.
+class DonchianLinearStorage
+{
+  private:
+    float offset = -40.0F; // Value of code 0
+    float scale = 125.0F / 65535.0F; // Value of one step
+
+  public:
+    typedef uint16_t Sample;
+
+    /*!
+    *  @brief  Set the range of values that can be stored. Should be set before tracking any data, since stored codes are not converted.
+    *  @param  low
+    *          Lowest value (default -40, the lowest temperature of the BME680)
+    *  @param  high
+    *          Highest value (default 85, the highest temperature of the BME680)
+    *  @return True if the range was set successfully, false if it is empty
+    */
+    bool setRange(float low, float high)
+    {
+      if (!(high > low)) return false;
+      offset = low;
+      scale = (high - low) / 65535.0F;
+      return true;
+    }
+
+    Sample encode(float x) const
+    {
+      float c = (x - offset) / scale + 0.5F;
+      if (!(c > 0.0F)) return 0; // Below the range, or NaN
+      if (c >= 65535.0F) return 65535;
+      return (Sample)c;
+    }
+    float decode(Sample s) const { return offset + (float)s * scale; }
+};
+
+// Logarithmic 16-bit fixed point storage, 2 bytes per data point, for values spanning several orders of magnitude such as gas resistance.
+// The relative error is at most half a step, i.e. ln(high / low) / 131070.
+class DonchianLogStorage
+{
+  private:
+    float logOffset = 2.302585F; // Logarithm of the value of code 0 (default 10)
+    float scale = (18.420681F - 2.302585F) / 65535.0F; // Logarithm of the ratio between neighboring codes (default range 10 to 1e8)
+
+  public:
+    typedef uint16_t Sample;
+
+    /*!
+    *  @brief  Set the range of values that can be stored. Should be set before tracking any data, since stored codes are not converted.
+    *  @param  low
+    *          Lowest value, above zero (default 10)
+    *  @param  high
+    *          Highest value (default 1e8)
+    *  @return True if the range was set successfully, false if it is invalid
+    */
+    bool setRange(float low, float high)
+    {
+      if (!(low > 0.0F && high > low)) return false;
+      logOffset = log(low);
+      scale = (log(high) - logOffset) / 65535.0F;
+      return true;
+    }
+
+    Sample encode(float x) const
+    {
+      if (!(x > 0.0F)) return 0; // Zero, negative or NaN
+      float c = (log(x) - logOffset) / scale + 0.5F;
+      if (!(c > 0.0F)) return 0;
+      if (c >= 65535.0F) return 65535;
+      return (Sample)c;
+    }
+    float decode(Sample s) const { return exp(logOffset + (float)s * scale); }
+};
+
+/*!
+*  @brief  Donchian average over a circular buffer of recent data points
+*  @tparam Storage
+*          Storage codec for the data points: DonchianFloatStorage, DonchianLinearStorage or DonchianLogStorage
+*/
+template <class Storage = DonchianFloatStorage>
+class DonchianAverageT
 {
+  public:
+    typedef typename Storage::Sample Sample; // Stored representation of one data point
+
   private:
-    float* data; // Array of data points
+    Sample* data = nullptr; // Array of data points
+    bool dataOwned = false; // Whether the data array was allocated by this object, as opposed to memory attached by the caller
     int dataSize = 0; // Number of data points
+    int windowSize = 0; // Number of most recent data points used for the min/max calculation, up to dataSize
     int cursor = 0; // Current index into the data array
     bool dataFull = false; // Set to true when the cursor wraps around and the array is full of data
     float rangeLimitMax = 0.0F; // Optional maximum limit for the min/max range. Lookback period for the calculation will auto-reduce to enforce this limit. Zero means no limit.
 
+    // Copy the history and settings of another object into this one, which holds no data array
+    void copyFrom(const DonchianAverageT& other)
+    {
+      data = other.data;
+      if (other.dataOwned)
+      {
+        data = new Sample[other.dataSize];
+        for (int i = 0; i < other.dataSize; i++) data[i] = other.data[i];
+      }
+      dataOwned = other.dataOwned;
+      dataSize = other.dataSize;
+      windowSize = other.windowSize;
+      cursor = other.cursor;
+      dataFull = other.dataFull;
+      rangeLimitMax = other.rangeLimitMax;
+      storage = other.storage;
+      current = other.current;
+      min = other.min;
+      max = other.max;
+      average = other.average;
+    }
+
   public:
+    Storage storage; // Storage codec, e.g. for setting the range of a 16-bit codec
     float current; // Current value for the metric, which is also at data[cursor]
     float min, max, average; // Statistics about the data in the array, updated each time new data points are added
 
+    // Constructor for an empty object without storage, which must be attached with attach() before tracking any data
+    DonchianAverageT() {}
+
     // Constructor
-    DonchianAverage(int dataArraySize, float rangeLimitMax = 0.0F)
+    DonchianAverageT(int dataArraySize, float rangeLimitMax = 0.0F)
     {
       // Allocate memory for data array
-      data = new float[dataArraySize];
+      data = new Sample[dataArraySize];
+      dataOwned = true;
       dataSize = dataArraySize;
+      windowSize = dataArraySize;
       dataFull = false;
       cursor = 0;
       this->rangeLimitMax = rangeLimitMax;
     }
 
+    // Copy constructor. A data array allocated by the constructor is copied, so both objects own their own array. Attached memory is shared until relocate().
+    DonchianAverageT(const DonchianAverageT& other)
+    {
+      copyFrom(other);
+    }
+
+    // Copy assignment, with the same ownership rules as the copy constructor
+    DonchianAverageT& operator=(const DonchianAverageT& other)
+    {
+      if (this != &other)
+      {
+        detach();
+        copyFrom(other);
+      }
+      return *this;
+    }
+
     // Destructor
-    ~DonchianAverage()
+    ~DonchianAverageT()
+    {
+      detach();
+    }
+
+    /*!
+    *  @brief  Use caller-supplied memory for the data array instead of the heap. Any previous history is discarded.
+    *  @param  buffer
+    *          Memory for at least dataArraySize samples, which must stay valid until detach() is called or another buffer is attached
+    *  @param  dataArraySize
+    *          Number of data points (at least 2)
+    *  @param  rangeLimitMax
+    *          Optional maximum limit for the min/max range, or zero for no limit
+    *  @return True if the buffer was attached, false if the parameters are invalid
+    */
+    bool attach(Sample* buffer, int dataArraySize, float rangeLimitMax = 0.0F)
     {
-      // Free memory
-      delete[] data;
+      if (buffer == nullptr || dataArraySize < 2) return false;
+      detach();
+      data = buffer;
+      dataSize = dataArraySize;
+      windowSize = dataArraySize;
+      this->rangeLimitMax = rangeLimitMax;
+      return true;
+    }
+
+    /*!
+    *  @brief  Release the data array. Memory allocated by the constructor is freed, and attached memory is handed back to the caller.
+    */
+    void detach(void)
+    {
+      if (dataOwned) delete[] data;
       data = nullptr;
-      dataSize = 0;
+      dataOwned = false;
+      dataSize = windowSize = 0;
+      reset();
     }
 
+    /*!
+    *  @brief  Point at a copy of the current data array, keeping the history and the window, e.g. after copying the owning object
+    *  @param  buffer
+    *          Copy of the data array, which must stay valid until detach() is called or another buffer is attached
+    */
+    void relocate(Sample* buffer)
+    {
+      data = buffer;
+      dataOwned = false;
+    }
+
+    /*!
+    *  @brief  Discard the history, keeping the data array and the window
+    */
+    void reset(void)
+    {
+      cursor = 0;
+      dataFull = false;
+    }
+
+    // Number of data points the data array can hold
+    int getCapacity(void) const { return dataSize; }
+
+    // Number of samples of storage needed by attach() for the given number of periods
+    static long storageSamples(int periods) { return periods; }
+
+    // Number of samples of storage the attached data array holds
+    long getStorageSamples(void) const { return dataSize; }
+
+    /*!
+    *  @brief  Change the lookback period without reallocating the data array. History already collected is kept.
+    *  @param  periods
+    *          Number of most recent data points to use for the min/max calculation (clamped to 2 through the data array size)
+    */
+    void setWindow(int periods)
+    {
+      if (periods < 2) periods = 2;
+      if (periods > dataSize) periods = dataSize;
+      windowSize = periods;
+    }
+
+    // Current lookback period
+    int getWindow(void) const { return windowSize; }
+
     // Track a new data point and recompute min/max/average values
     void track(float dataPoint)
     {
@@ -48,7 +270,7 @@ class DonchianAverage
       current = dataPoint;
 
       // Add a new data point to the tracking array
-      data[cursor] = dataPoint;
+      data[cursor] = storage.encode(dataPoint);
       cursor++;
       if (cursor >= dataSize)
       {
@@ -58,19 +280,34 @@ class DonchianAverage
 
       // Compute min/max/average values from the data array
       int j = dataFull ? dataSize : cursor;
+      if (j > windowSize) j = windowSize; // Limit the lookback to the current window
       int k = cursor - 1; // Most recent index in the data array
       if (k < 0) k = dataSize - 1; // Wrap around at the beginning of the array
-      float min = max = data[k]; // Start with the most recent data point and a range of zero
+      Sample minSample, maxSample;
+      minSample = maxSample = data[k];
+      float min = max = storage.decode(data[k]); // Start with the most recent data point and a range of zero
       for (int i = 1; i < j; i++)
       {
         // Walk backwards through the data array
         k--;
         if (k < 0) k = dataSize - 1; // Wrap around
 
-        // Track min and max values
-        float d = data[k];
-        if (d < min) min = d;
-        if (d > max) max = d;
+        // Track min and max values. Codecs are monotonic, so only new extremes need to be decoded.
+        Sample d = data[k];
+        if (d < minSample)
+        {
+          minSample = d;
+          min = storage.decode(d);
+        }
+        else if (d > maxSample)
+        {
+          maxSample = d;
+          max = storage.decode(d);
+        }
+        else
+        {
+          continue; // Range unchanged
+        }
 
         // If (a range limit was specified AND the current range exceeds that limit)...
         if (rangeLimitMax != 0.0F && (max - min) > rangeLimitMax)
@@ -97,4 +334,7 @@ class DonchianAverage
     }
 };
 
+// Donchian average with full precision storage
+typedef DonchianAverageT<> DonchianAverage;
+
 #endif
@@ -0,0 +1,307 @@
+/**
+ * @file  DonchianBlockAverage.h
+ * @brief Donchian average for very long windows (e.g. a day of samples) that keeps only the min/max of each block of samples instead of every sample.
+ *        Memory is O(N/B) for a window of N samples and blocks of B samples: four values per block (block min/max, plus cumulative min/max from the newest block
+ *        back, which are rebuilt once per completed block). Each new sample costs O(1) without a range limit and O(log(N/B)) with one, plus O(N/B) once per block.
+ *
+ *        Trade-offs compared to DonchianAverage:
+ *          The window is whole blocks plus the current partial block of 1 to B samples, so the lookback is between the requested periods and about 2B samples more.
+ *          Samples leave the window a whole block at a time, so an old extreme can persist up to B samples longer.
+ *          The range limit lookback stops at block boundaries: a block is either fully included or not at all, so the clipped side of a limited channel can differ
+ *          from the per-sample result by up to the spread of the values within one block.
+ *        With B much smaller than the oscillation period being smoothed, the difference is negligible.
+ */
+
+#ifndef __DONCHIAN_BLOCK_AVERAGE_H__
+#define __DONCHIAN_BLOCK_AVERAGE_H__
+
+#include <limits.h>
+#include <DonchianAverage.h>
+
+/*!
+*  @brief  Donchian average over per-block min/max summaries of recent data points
+*  @tparam Storage
+*          Storage codec for the summaries: DonchianFloatStorage, DonchianLinearStorage or DonchianLogStorage
+*  @tparam BlockSize
+*          Number of samples summarized by each block
+*/
+template <class Storage = DonchianFloatStorage, int BlockSize = 64>
+class DonchianBlockAverageT
+{
+  public:
+    typedef typename Storage::Sample Sample; // Stored representation of one value
+
+  private:
+    Sample* blockMin = nullptr;  // Min of each completed block, circular
+    Sample* blockMax = nullptr;  // Max of each completed block, circular
+    Sample* prefixMin = nullptr; // Min of the i + 1 newest completed blocks within the window
+    Sample* prefixMax = nullptr; // Max of the i + 1 newest completed blocks within the window
+    bool dataOwned = false; // Whether the arrays were allocated by this object, as opposed to memory attached by the caller
+    int blockCapacity = 0; // Number of completed blocks the arrays can hold
+    int windowBlocks = 0; // Number of completed blocks used for the min/max calculation, up to blockCapacity
+    int newest = 0; // Index of the newest completed block
+    long completed = 0; // Number of completed blocks since the last reset
+    Sample partialMin, partialMax; // Min and max of the current partial block
+    int partialCount = 0; // Number of samples in the current partial block
+    float rangeLimitMax = 0.0F; // Optional maximum limit for the min/max range. Lookback period for the calculation will auto-reduce to enforce this limit. Zero means no limit.
+
+    // Number of completed blocks currently in the window
+    int validBlocks(void) const { return completed < windowBlocks ? (int)completed : windowBlocks; }
+
+    // Rebuild the cumulative min/max arrays from the newest block back, once per completed block
+    void rebuildPrefix(void)
+    {
+      int n = validBlocks();
+      int k = newest;
+      for (int i = 0; i < n; i++)
+      {
+        prefixMin[i] = (i == 0 || blockMin[k] < prefixMin[i - 1]) ? blockMin[k] : prefixMin[i - 1];
+        prefixMax[i] = (i == 0 || blockMax[k] > prefixMax[i - 1]) ? blockMax[k] : prefixMax[i - 1];
+        k--;
+        if (k < 0) k = blockCapacity - 1; // Wrap around
+      }
+    }
+
+    // Copy the history and settings of another object into this one, which holds no block arrays
+    void copyFrom(const DonchianBlockAverageT& other)
+    {
+      blockMin = other.blockMin;
+      if (other.dataOwned)
+      {
+        long samples = 4L * other.blockCapacity;
+        blockMin = new Sample[samples];
+        for (long i = 0; i < samples; i++) blockMin[i] = other.blockMin[i];
+      }
+      blockMax = blockMin + other.blockCapacity;
+      prefixMin = blockMin + 2L * other.blockCapacity;
+      prefixMax = blockMin + 3L * other.blockCapacity;
+      dataOwned = other.dataOwned;
+      blockCapacity = other.blockCapacity;
+      windowBlocks = other.windowBlocks;
+      newest = other.newest;
+      completed = other.completed;
+      partialMin = other.partialMin;
+      partialMax = other.partialMax;
+      partialCount = other.partialCount;
+      rangeLimitMax = other.rangeLimitMax;
+      storage = other.storage;
+      current = other.current;
+      min = other.min;
+      max = other.max;
+      average = other.average;
+    }
+
+  public:
+    Storage storage; // Storage codec, e.g. for setting the range of a 16-bit codec
+    float current; // Current value for the metric
+    float min, max, average; // Statistics about the data in the window, updated each time new data points are added
+
+    // Constructor for an empty object without storage, which must be attached with attach() before tracking any data
+    DonchianBlockAverageT() {}
+
+    // Constructor
+    DonchianBlockAverageT(int periods, float rangeLimitMax = 0.0F)
+    {
+      // Allocate memory for the block arrays
+      Sample* buffer = new Sample[storageSamples(periods)];
+      attach(buffer, periods, rangeLimitMax);
+      dataOwned = true;
+    }
+
+    // Copy constructor. Block arrays allocated by the constructor are copied, so both objects own their own arrays. Attached memory is shared until relocate().
+    DonchianBlockAverageT(const DonchianBlockAverageT& other)
+    {
+      copyFrom(other);
+    }
+
+    // Copy assignment, with the same ownership rules as the copy constructor
+    DonchianBlockAverageT& operator=(const DonchianBlockAverageT& other)
+    {
+      if (this != &other)
+      {
+        detach();
+        copyFrom(other);
+      }
+      return *this;
+    }
+
+    // Destructor
+    ~DonchianBlockAverageT()
+    {
+      detach();
+    }
+
+    // Number of samples of storage needed by attach() for the given number of periods
+    static long storageSamples(int periods) { return 4L * blocksFor(periods); }
+
+    // Number of completed blocks that, together with the partial block, cover at least the given number of periods
+    static int blocksFor(int periods)
+    {
+      long blocks = ((long)periods - 1 + BlockSize - 1) / BlockSize; // In long, so periods close to INT_MAX do not overflow
+      return blocks < 1 ? 1 : (int)blocks;
+    }
+
+    // Number of samples of storage the attached block arrays hold
+    long getStorageSamples(void) const { return 4L * blockCapacity; }
+
+    /*!
+    *  @brief  Use caller-supplied memory for the block arrays instead of the heap. Any previous history is discarded.
+    *  @param  buffer
+    *          Memory for at least storageSamples(periods) samples, which must stay valid until detach() is called or another buffer is attached
+    *  @param  periods
+    *          Number of periods in the window (at least 2), rounded up to whole blocks plus the partial block
+    *  @param  rangeLimitMax
+    *          Optional maximum limit for the min/max range, or zero for no limit
+    *  @return True if the buffer was attached, false if the parameters are invalid
+    */
+    bool attach(Sample* buffer, int periods, float rangeLimitMax = 0.0F)
+    {
+      if (buffer == nullptr || periods < 2) return false;
+      detach();
+      blockCapacity = windowBlocks = blocksFor(periods);
+      blockMin = buffer;
+      blockMax = buffer + blockCapacity;
+      prefixMin = buffer + 2L * blockCapacity;
+      prefixMax = buffer + 3L * blockCapacity;
+      this->rangeLimitMax = rangeLimitMax;
+      return true;
+    }
+
+    /*!
+    *  @brief  Release the block arrays. Memory allocated by the constructor is freed, and attached memory is handed back to the caller.
+    */
+    void detach(void)
+    {
+      if (dataOwned) delete[] blockMin;
+      blockMin = blockMax = prefixMin = prefixMax = nullptr;
+      dataOwned = false;
+      blockCapacity = windowBlocks = 0;
+      reset();
+    }
+
+    /*!
+    *  @brief  Point at a copy of the current block arrays, keeping the history and the window, e.g. after copying the owning object
+    *  @param  buffer
+    *          Copy of the block arrays, which must stay valid until detach() is called or another buffer is attached
+    */
+    void relocate(Sample* buffer)
+    {
+      blockMin = buffer;
+      blockMax = buffer + blockCapacity;
+      prefixMin = buffer + 2L * blockCapacity;
+      prefixMax = buffer + 3L * blockCapacity;
+      dataOwned = false;
+    }
+
+    /*!
+    *  @brief  Discard the history, keeping the block arrays and the window
+    */
+    void reset(void)
+    {
+      newest = 0;
+      completed = 0;
+      partialCount = 0;
+    }
+
+    // Largest lookback period in data points, counting at least one sample of the partial block
+    int getCapacity(void) const
+    {
+      long capacity = (long)blockCapacity * BlockSize + 1;
+      return capacity < INT_MAX ? (int)capacity : INT_MAX;
+    }
+
+    /*!
+    *  @brief  Change the lookback period without reallocating the block arrays. History already collected is kept.
+    *  @param  periods
+    *          Number of most recent data points to use for the min/max calculation, rounded up to whole blocks (limited to the capacity)
+    */
+    void setWindow(int periods)
+    {
+      int blocks = blocksFor(periods);
+      if (blocks > blockCapacity) blocks = blockCapacity;
+      windowBlocks = blocks;
+      rebuildPrefix();
+    }
+
+    // Current lookback period in data points, counting at least one sample of the partial block
+    int getWindow(void) const
+    {
+      long window = (long)windowBlocks * BlockSize + 1;
+      return window < INT_MAX ? (int)window : INT_MAX;
+    }
+
+    // Track a new data point and recompute min/max/average values
+    void track(float dataPoint)
+    {
+      // Capture the current value
+      current = dataPoint;
+
+      // Add the new data point to the partial block
+      Sample c = storage.encode(dataPoint);
+      if (partialCount == 0 || c < partialMin) partialMin = c;
+      if (partialCount == 0 || c > partialMax) partialMax = c;
+      partialCount++;
+
+      // Start with the partial block, then extend the lookback over the completed blocks
+      float min = storage.decode(partialMin);
+      max = storage.decode(partialMax);
+      int n = validBlocks();
+      bool limited = rangeLimitMax != 0.0F && (max - min) > rangeLimitMax;
+      if (!limited && n > 0)
+      {
+        int i = n - 1; // Whole window if no range limit is exceeded
+        if (rangeLimitMax != 0.0F)
+        {
+          // The range only grows with the lookback, so binary search the first block count that exceeds the limit
+          int low = 0, high = n; // Answer in [low, high], where n means the limit is never exceeded
+          while (low < high)
+          {
+            int mid = (low + high) / 2;
+            float mn = storage.decode(prefixMin[mid] < partialMin ? prefixMin[mid] : partialMin);
+            float mx = storage.decode(prefixMax[mid] > partialMax ? prefixMax[mid] : partialMax);
+            if (mx - mn > rangeLimitMax) high = mid;
+            else low = mid + 1;
+          }
+          if (low < n)
+          {
+            i = low;
+            limited = true;
+          }
+        }
+        if (prefixMin[i] < partialMin) min = storage.decode(prefixMin[i]);
+        if (prefixMax[i] > partialMax) max = storage.decode(prefixMax[i]);
+      }
+
+      // If the range limit was exceeded, adjust min or max to enforce the specified range limit with respect to the breakout direction
+      if (limited)
+      {
+        if (max - dataPoint < dataPoint - min) // If (breakout direction is UP)...
+        {
+          min = max - rangeLimitMax; // Breakout to the upside, so raise min
+        }
+        else
+        {
+          max = min + rangeLimitMax; // Breakout to the downside, so lower max
+        }
+      }
+
+      // Update the public min/max/average values
+      this->min = min;
+      this->max = max;
+      this->average = (min + max) / 2.0F; // Donchian Average is the midpoint between min and max
+
+      // Close the partial block when it is full
+      if (partialCount >= BlockSize)
+      {
+        newest++;
+        if (newest >= blockCapacity) newest = 0; // Wrap around
+        blockMin[newest] = partialMin;
+        blockMax[newest] = partialMax;
+        completed++;
+        partialCount = 0;
+        rebuildPrefix();
+      }
+    }
+};
+
+#endif
@@ -0,0 +1,118 @@
+/**
+ * @file  ExponentialAverage.h
+ * @brief Helper class to smooth sensor measurements using an exponentially weighted moving average (EWMA), optionally paired with a faster EWMA for breakout detection.
+ *        This is a constant memory alternative to DonchianAverage: each update is O(1) and no sample history is stored.
+ *        A smoothing factor of 2 / (periods + 1) gives the same average lag as a window of the same number of periods.
+ * @link  https://en.wikipedia.org/wiki/Exponential_smoothing
+ */
+
+#ifndef __EXPONENTIAL_AVERAGE_H__
+#define __EXPONENTIAL_AVERAGE_H__
+
+class ExponentialAverage
+{
+  private:
+    float alphaSlow = 1.0F; // Smoothing factor for the slow (main) average
+    float alphaFast = 0.0F; // Smoothing factor for the fast average, zero when the fast/slow pair is disabled
+    float rangeLimitMax = 0.0F; // Optional maximum distance between the fast and slow averages. The slow average is dragged along with the fast average to enforce this limit. Zero means no limit.
+    bool seeded = false; // Set to true after the first data point has been tracked
+
+  public:
+    float current; // Current value for the metric
+    float slow, fast; // Slow and fast averages, updated each time new data points are added
+    float average; // Smoothed value, which is the slow average
+
+    // Constructor
+    ExponentialAverage(int periods = 2, int fastPeriods = 0, float rangeLimitMax = 0.0F)
+    {
+      configure(periods, fastPeriods, rangeLimitMax);
+    }
+
+    /*!
+    *  @brief  Set the time constants and restart smoothing
+    *  @param  periods
+    *          Number of periods for the slow average (at least 1)
+    *  @param  fastPeriods
+    *          Number of periods for the fast average used for breakout detection, or zero to disable the fast/slow pair
+    *  @param  rangeLimitMax
+    *          Maximum distance between the fast and slow averages before the slow average follows the breakout. Zero means no limit.
+    */
+    void configure(int periods, int fastPeriods = 0, float rangeLimitMax = 0.0F)
+    {
+      setPeriods(periods, fastPeriods);
+      this->rangeLimitMax = rangeLimitMax;
+      seeded = false;
+    }
+
+    /*!
+    *  @brief  Change the time constants without restarting smoothing
+    *  @param  periods
+    *          Number of periods for the slow average (at least 1)
+    *  @param  fastPeriods
+    *          Number of periods for the fast average used for breakout detection, or zero to disable the fast/slow pair
+    */
+    void setPeriods(int periods, int fastPeriods = 0)
+    {
+      if (periods < 1) periods = 1;
+      alphaSlow = 2.0F / (float)(periods + 1);
+      alphaFast = fastPeriods > 0 ? 2.0F / (float)(fastPeriods + 1) : 0.0F;
+    }
+
+    // Restart smoothing, keeping the time constants. The next data point seeds the averages.
+    void reset(void)
+    {
+      seeded = false;
+    }
+
+    // Resume the averages of another instance, e.g. one saved before a restart, keeping the time constants and range limit of this one
+    void resume(const ExponentialAverage& saved)
+    {
+      seeded = saved.seeded;
+      current = saved.current;
+      slow = saved.slow;
+      fast = saved.fast;
+      average = saved.average;
+    }
+
+    // Track a new data point and update the averages
+    void track(float dataPoint)
+    {
+      // Capture the current value
+      current = dataPoint;
+
+      // Seed the averages with the first data point
+      if (!seeded)
+      {
+        slow = fast = average = dataPoint;
+        seeded = true;
+        return;
+      }
+
+      // Update the slow average
+      slow += alphaSlow * (dataPoint - slow);
+
+      // If (the fast/slow pair is enabled)...
+      if (alphaFast > 0.0F)
+      {
+        // Update the fast average
+        fast += alphaFast * (dataPoint - fast);
+
+        // If (a range limit was specified)...
+        if (rangeLimitMax != 0.0F)
+        {
+          // Drag the slow average along if the fast average breaks out of the allowed range
+          if (fast - slow > rangeLimitMax) slow = fast - rangeLimitMax; // Breakout to the upside, so raise the slow average
+          else if (slow - fast > rangeLimitMax) slow = fast + rangeLimitMax; // Breakout to the downside, so lower the slow average
+        }
+      }
+      else
+      {
+        fast = slow;
+      }
+
+      // Update the public average
+      average = slow;
+    }
+};
+
+#endif
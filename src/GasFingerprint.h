@@ -0,0 +1,142 @@
+/**
+ * @file  GasFingerprint.h
+ * @brief Lightweight nearest-centroid classifier for gas signatures collected with a multi-step heater scan. The gas resistances measured at several heater
+ *        temperatures are converted to a normalized log-resistance vector: logarithms remove the exponential scale of the MOX response, subtracting the
+ *        mean removes the overall baseline (drift, humidity), and scaling to unit length leaves only the shape of the response across temperatures.
+ *        Classification compares that shape against trained centroids, which costs one logarithm per step and one multiply-add per step and class.
+ *        Centroids are produced on a host computer by extras/fingerprint_trainer from recorded scans, using the same normalization.
+ */
+
+#ifndef __GAS_FINGERPRINT_H__
+#define __GAS_FINGERPRINT_H__
+
+#include <math.h>
+
+// Centroid tables are stored in flash. AVR needs explicit flash reads, other architectures map flash into the address space.
+#if defined(__AVR__)
+#include <avr/pgmspace.h>
+#define GAS_FINGERPRINT_READ(p) pgm_read_float(p)
+#else
+#ifndef PROGMEM
+#define PROGMEM
+#endif
+#define GAS_FINGERPRINT_READ(p) (*(p))
+#endif
+
+// Maximum number of heater steps in a scan
+#ifndef GAS_FINGERPRINT_STEPS_MAX
+#define GAS_FINGERPRINT_STEPS_MAX 10
+#endif
+
+class GasFingerprint
+{
+  private:
+    const float* centroids = nullptr; // Trained centroids in flash, one normalized vector of steps values per class
+    int classes = 0; // Number of trained classes
+    int steps = 0; // Number of heater steps per scan
+    float maxDistance = 0.0F; // Scans further than this from every centroid are reported as unknown. Zero means no limit.
+
+  public:
+    int match = -1; // Index of the nearest class after classify(), or -1 if the scan is unknown or invalid
+    float distance = 0.0F; // Squared distance to the nearest centroid (0-4, smaller is better)
+    float margin = 0.0F; // Difference between the squared distances to the second nearest and nearest centroids (larger is more certain)
+
+    /*!
+    *  @brief  Normalize a scan into a unit length, zero mean log-resistance vector
+    *  @param  resistances
+    *          Gas resistances in ohms, one per heater step
+    *  @param  count
+    *          Number of heater steps (1 to GAS_FINGERPRINT_STEPS_MAX)
+    *  @param  normalized
+    *          Output vector with count values
+    *  @return True if the scan was normalized successfully, false if it contains invalid resistances or has no shape (all steps equal)
+    */
+    static bool normalize(const float* resistances, int count, float* normalized)
+    {
+      if (count < 1 || count > GAS_FINGERPRINT_STEPS_MAX) return false;
+      float mean = 0.0F;
+      for (int i = 0; i < count; i++)
+      {
+        if (!(resistances[i] > 0.0F)) return false; // Zero, negative or NaN
+        normalized[i] = logf(resistances[i]);
+        mean += normalized[i];
+      }
+      mean /= (float)count;
+      float norm = 0.0F;
+      for (int i = 0; i < count; i++)
+      {
+        normalized[i] -= mean;
+        norm += normalized[i] * normalized[i];
+      }
+      if (norm <= 1e-12F) return false; // Flat response, no shape to classify
+      norm = 1.0F / sqrtf(norm);
+      for (int i = 0; i < count; i++) normalized[i] *= norm;
+      return true;
+    }
+
+    /*!
+    *  @brief  Set the trained centroids
+    *  @param  centroidTable
+    *          Table of classCount * stepCount normalized values in flash (PROGMEM), as generated by extras/fingerprint_trainer
+    *  @param  classCount
+    *          Number of trained classes
+    *  @param  stepCount
+    *          Number of heater steps per scan (1 to GAS_FINGERPRINT_STEPS_MAX)
+    *  @param  maxDistance
+    *          Scans with a larger squared distance to every centroid are reported as unknown. Zero means no limit.
+    *  @return True if the centroids were set successfully, false if the parameters are invalid
+    */
+    bool begin(const float* centroidTable, int classCount, int stepCount, float maxDistance = 0.0F)
+    {
+      if (centroidTable == nullptr || classCount < 1 || stepCount < 1 || stepCount > GAS_FINGERPRINT_STEPS_MAX) return false;
+      centroids = centroidTable;
+      classes = classCount;
+      steps = stepCount;
+      this->maxDistance = maxDistance;
+      return true;
+    }
+
+    /*!
+    *  @brief  Classify a scan against the trained centroids
+    *  @param  resistances
+    *          Gas resistances in ohms, one per heater step, in the same order as the training data
+    *  @return Index of the nearest class, or -1 if the scan is unknown or invalid
+    */
+    int classify(const float* resistances)
+    {
+      match = -1;
+      distance = margin = 0.0F;
+      float v[GAS_FINGERPRINT_STEPS_MAX];
+      if (classes == 0 || !normalize(resistances, steps, v)) return match;
+
+      // Find the nearest and second nearest centroids
+      float best = 1e30F, second = 1e30F;
+      const float* c = centroids;
+      for (int k = 0; k < classes; k++)
+      {
+        float d = 0.0F;
+        for (int i = 0; i < steps; i++)
+        {
+          float e = v[i] - GAS_FINGERPRINT_READ(&c[i]);
+          d += e * e;
+        }
+        c += steps;
+        if (d < best)
+        {
+          second = best;
+          best = d;
+          match = k;
+        }
+        else if (d < second)
+        {
+          second = d;
+        }
+      }
+      distance = best;
+      margin = classes > 1 ? second - best : 0.0F;
+      if (maxDistance > 0.0F && best > maxDistance) match = -1; // Too far from every trained class
+      return match;
+    }
+};
+
+#endif
@@ -0,0 +1,143 @@
+/**
+ * @file  HampelFilter.h
+ * @brief Helper class to reject single-sample spikes using a streaming Hampel filter: a sample is an outlier when it is further from the median of the
+ *        trailing window than a multiple of the scaled median absolute deviation (MAD). Outliers are replaced by the window median and counted.
+ *        The window is kept both in arrival order and sorted. The sorted copy is maintained with binary searches and up to two memmoves of the window,
+ *        so each update is O(W) for a window of W samples. The median and MAD are then selected from it in O(log W) without sorting the deviations.
+ * @link  https://en.wikipedia.org/wiki/Median_absolute_deviation
+ */
+
+#ifndef __HAMPEL_FILTER_H__
+#define __HAMPEL_FILTER_H__
+
+#include <string.h>
+
+// Maximum supported window size, in samples
+#ifndef HAMPEL_WINDOW_MAX
+#define HAMPEL_WINDOW_MAX 15
+#endif
+
+class HampelFilter
+{
+  private:
+    float data[HAMPEL_WINDOW_MAX];   // Window in arrival order (circular buffer)
+    float sorted[HAMPEL_WINDOW_MAX]; // Window in ascending order
+    int windowSize = 7; // Number of samples in the window
+    int count = 0; // Number of samples currently in the window
+    int cursor = 0; // Index of the oldest sample in data[] once the window is full
+    float threshold = 3.0F; // Number of scaled MADs a sample may deviate from the median before it is rejected
+    float minDeviation = 0.01F; // Minimum allowed deviation as a fraction of the median, so a perfectly flat window does not reject ordinary noise
+
+    // Index of the first element in sorted[] that is not less than value
+    int lowerBound(float value) const
+    {
+      int lo = 0, hi = count;
+      while (lo < hi)
+      {
+        int mid = (lo + hi) / 2;
+        if (sorted[mid] < value) lo = mid + 1; else hi = mid;
+      }
+      return lo;
+    }
+
+    // Median of the sorted window
+    float median(void) const
+    {
+      int mid = count / 2;
+      return (count & 1) ? sorted[mid] : (sorted[mid - 1] + sorted[mid]) / 2.0F;
+    }
+
+    // k-th smallest (zero based) absolute deviation from the median. The deviations below and above the split point form two ascending sequences,
+    // so the k-th smallest of their union is found with a binary search over how many elements are taken from the lower sequence.
+    float kthDeviation(float m, int split, int k) const
+    {
+      int nLow = split, nHigh = count - split; // Deviations below the median are m - sorted[split - 1 - i], above are sorted[split + j] - m
+      int c = k + 1; // Number of deviations to take in total
+      int lo = c > nHigh ? c - nHigh : 0, hi = c < nLow ? c : nLow;
+      while (lo < hi)
+      {
+        int i = (lo + hi) / 2; // Candidate count taken from the lower sequence
+        float nextLow = m - sorted[split - 1 - i];
+        float lastHigh = sorted[split + (c - i) - 1] - m;
+        if (nextLow < lastHigh) lo = i + 1; else hi = i;
+      }
+      int i = lo, j = c - lo;
+      float dLow = i > 0 ? m - sorted[split - i] : 0.0F;
+      float dHigh = j > 0 ? sorted[split + j - 1] - m : 0.0F;
+      return dLow > dHigh ? dLow : dHigh;
+    }
+
+  public:
+    unsigned long rejected = 0; // Number of samples rejected as outliers since the last reset
+
+    /*!
+    *  @brief  Set the filter parameters and clear the window
+    *  @param  window
+    *          Number of samples in the trailing window (3 to HAMPEL_WINDOW_MAX)
+    *  @param  threshold
+    *          Number of scaled MADs a sample may deviate from the median before it is rejected (typically 3)
+    *  @param  minDeviation
+    *          Minimum allowed deviation as a fraction of the median
+    *  @return True if the parameters were set successfully, false if they are invalid
+    */
+    bool configure(int window, float threshold = 3.0F, float minDeviation = 0.01F)
+    {
+      if (window < 3 || window > HAMPEL_WINDOW_MAX || threshold <= 0.0F || minDeviation < 0.0F) return false;
+      windowSize = window;
+      this->threshold = threshold;
+      this->minDeviation = minDeviation;
+      reset();
+      return true;
+    }
+
+    // Clear the window and the rejection counter
+    void reset(void)
+    {
+      count = 0;
+      cursor = 0;
+      rejected = 0;
+    }
+
+    // Filter a new data point, returning either the data point itself or the window median if the data point is an outlier
+    float filter(float dataPoint)
+    {
+      float result = dataPoint;
+
+      if (count == windowSize)
+      {
+        // Test the data point against the median and MAD of the trailing window. 1.4826 scales the MAD to a standard deviation for normal data.
+        float m = median();
+        int split = lowerBound(m);
+        int k = count / 2;
+        float mad = kthDeviation(m, split, k);
+        if (!(count & 1)) mad = (mad + kthDeviation(m, split, k - 1)) / 2.0F;
+        float limit = threshold * 1.4826F * mad;
+        float minLimit = minDeviation * (m < 0.0F ? -m : m);
+        if (limit < minLimit) limit = minLimit;
+        float deviation = dataPoint - m;
+        if (deviation > limit || -deviation > limit)
+        {
+          result = m; // Replace the outlier with the median
+          rejected++;
+        }
+
+        // Remove the oldest sample from the sorted window
+        int oldest = lowerBound(data[cursor]);
+        memmove(&sorted[oldest], &sorted[oldest + 1], (count - oldest - 1) * sizeof(float));
+        count--;
+      }
+
+      // Insert the raw data point, so that genuine step changes are accepted once they dominate the window
+      int position = lowerBound(dataPoint);
+      memmove(&sorted[position + 1], &sorted[position], (count - position) * sizeof(float));
+      sorted[position] = dataPoint;
+      count++;
+      data[cursor] = dataPoint;
+      cursor++;
+      if (cursor >= windowSize) cursor = 0; // Wrap around
+
+      return result;
+    }
+};
+
+#endif
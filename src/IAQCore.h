@@ -0,0 +1,648 @@
+/**
+ * @file  IAQCore.h
+ * @brief Hardware-independent core of SE_BME680: temperature and humidity compensation, dew point, derived metrics, smoothing, gas calibration and IAQ.
+ *        The core holds no bus or sensor types and is driven by process() with raw readings and a timestamp, so the exact same algorithm can run on the
+ *        sensor board (through SE_BME680, which is a thin adapter over this class) or in a gateway for readings received from remote sensors.
+ */
+
+#ifndef __IAQ_CORE_H__
+#define __IAQ_CORE_H__
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#else
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+#endif
+#include <limits.h>
+#include <SE_BME680_config.h>
+#include <MagnusTable.h>
+#if SE_BME680_ENABLE_SMOOTHING
+#include <DonchianAverage.h>
+#if SE_BME680_DONCHIAN_BLOCK_SIZE > 0
+#include <DonchianBlockAverage.h>
+#endif
+#include <ExponentialAverage.h>
+#include <OscillationDetector.h>
+#endif
+#if SE_BME680_ENABLE_IAQ
+#include <HampelFilter.h>
+#include <IAQPolicies.h>
+#else
+struct DefaultIAQPolicy {}; // Placeholder so the template default still works when the IAQ subsystem is compiled out
+#endif
+
+#if SE_BME680_ENABLE_DERIVED_METRICS
+// Extended derived metrics, combined with | and passed to setDerivedMetrics()
+#define SE_BME680_METRIC_NONE               0x00
+#define SE_BME680_METRIC_ABSOLUTE_HUMIDITY  0x01
+#define SE_BME680_METRIC_HEAT_INDEX         0x02
+#define SE_BME680_METRIC_HUMIDEX            0x04
+#define SE_BME680_METRIC_MIXING_RATIO       0x08
+#define SE_BME680_METRIC_SEA_LEVEL_PRESSURE 0x10
+#define SE_BME680_METRIC_ALTITUDE           0x20
+#define SE_BME680_METRIC_ALL                0x3F
+#endif
+
+/*!
+*  @brief  Compensation and IAQ state machine for one sensor, independent of the sensor hardware
+*  @tparam IAQPolicy
+*          Bundle of IAQ strategies (compensation model, gas ceiling estimator and scoring curve), see IAQPolicies.h
+*/
+template <class IAQPolicy = DefaultIAQPolicy>
+class IAQCoreT
+{
+  private:
+
+    // Data members are ordered cold to hot: configuration and history buffers first, then the state touched by every reading, which runs on into the
+    // hot end of the gas ceiling estimator and the public outputs so that it shares as few cache lines as possible
+
+#if SE_BME680_ENABLE_SMOOTHING
+    // Donchian history storage: full precision, or 16-bit fixed point to halve the memory
+#if SE_BME680_QUANTIZED_SMOOTHING
+    typedef DonchianLinearStorage ClimateStorage; // Temperature and humidity
+    typedef DonchianLogStorage GasStorage;        // Gas resistance
+#else
+    typedef DonchianFloatStorage ClimateStorage;
+    typedef DonchianFloatStorage GasStorage;
+#endif
+
+    // Donchian history layout: every sample, or min/max summaries of blocks of samples for very long periods
+#if SE_BME680_DONCHIAN_BLOCK_SIZE > 0
+    typedef DonchianBlockAverageT<ClimateStorage, SE_BME680_DONCHIAN_BLOCK_SIZE> ClimateDonchian;
+    typedef DonchianBlockAverageT<GasStorage, SE_BME680_DONCHIAN_BLOCK_SIZE> GasDonchian;
+#else
+    typedef DonchianAverageT<ClimateStorage> ClimateDonchian;
+    typedef DonchianAverageT<GasStorage> GasDonchian;
+#endif
+    typedef typename ClimateDonchian::Sample DonchianSample; // Both channel types store the same sample type
+
+    // Storage for the three Donchian data arrays: a caller-supplied arena, the embedded pool, or a heap block that is reused until smoothing is disabled
+#if SE_BME680_SMOOTHING_POOL_SIZE > 0
+    float smoothing_pool[SE_BME680_SMOOTHING_POOL_SIZE]; // Storage embedded in the object
+#endif
+    float* smoothing_arena = nullptr; // Caller-supplied memory, if any
+    int smoothing_arena_size = 0;     // Size of the caller-supplied memory in floats
+    float* smoothing_heap = nullptr;  // Heap block, only used without an arena or a pool
+    int smoothing_heap_size = 0;      // Size of the heap block in floats
+
+    // Minimum detection confidence (0-1) required before the smoothing period is changed
+    float auto_smoothing_confidence = 0.35F;
+
+    // Detector for the dominant oscillation period of the raw temperature and humidity readings
+    OscillationDetector oscillation_detector;
+#endif
+
+#if SE_BME680_ENABLE_IAQ
+    // Hampel spike filter for the raw gas resistance, if enabled
+    HampelFilter gas_spike_filter;
+#endif
+
+#if SE_BME680_ENABLE_DERIVED_METRICS
+    // Ratio of sea-level pressure to station pressure, precomputed from the station altitude
+    float sea_level_pressure_factor = 1.0F;
+
+    // Sea-level reference pressure in hPa for the altitude calculation
+    float altitude_reference_pressure = 1013.25F;
+#endif
+
+#if SE_BME680_ENABLE_SMOOTHING
+    // Smoothing for sensor readings used in the IAQ calculation, if enabled
+    ClimateDonchian temperature_donchian; // Smoothing for the raw temperature
+    ClimateDonchian humidity_donchian;    // Smoothing for the raw humidity
+    GasDonchian gas_resistance_donchian;  // Smoothing for the raw gas
+
+    // Exponential smoothing for sensor readings used in the IAQ calculation, as a constant memory alternative to Donchian smoothing, if enabled
+    ExponentialAverage temperature_exponential;    // Smoothing for the raw temperature
+    ExponentialAverage humidity_exponential;       // Smoothing for the raw humidity
+    ExponentialAverage gas_resistance_exponential; // Smoothing for the raw gas
+
+    // Current smoothing period in samples, and the fast period for exponential smoothing (zero if not used)
+    int smoothing_periods = 0;
+    int smoothing_fast_periods = 0;
+#endif
+
+    // Temperature offset in degrees Celsius, added to the raw temperature reading and used to compensate humidity and dew point calculations
+    float temperature_offset = -2.00F;
+
+#if SE_BME680_ENABLE_IAQ
+    // Ignore any values lower than this for the purposes of calculating the gas ceiling
+    uint32_t gas_resistance_limit_min = 50000;
+
+    // Ignore any values higher than this for the purposes of calculating the gas ceiling, which is important if the sensor is started in a low air quality environment
+    uint32_t gas_resistance_limit_max = 225000;
+
+    // Inputs of the pending IAQ score in lazy mode, captured while the gas calibration advances
+    double iaq_pending_compensated_gas_r = 0;
+    double iaq_pending_gas_ceiling = 0;
+
+    // IAQ strategies selected by the policy bundle. The estimator keeps its calibration array first and its per-reading state last.
+    typename IAQPolicy::Compensation gas_compensation; // Humidity compensation model for gas resistance
+    typename IAQPolicy::Ceiling gas_ceiling_estimator; // Gas ceiling estimator, including calibration stages and accuracy
+    typedef typename IAQPolicy::Scoring Scoring;       // Scoring curve mapping compensated gas resistance to IAQ
+#endif
+
+    // Raw inputs of the last reading, kept for the derived outputs in lazy mode
+    float input_temperature = NAN; // Celsius
+    float input_humidity = NAN;    // RH %
+#if SE_BME680_ENABLE_DERIVED_METRICS
+    float input_pressure = NAN;    // Pa
+
+    // Extended derived metrics computed in each reading (SE_BME680_METRIC_* flags)
+    uint8_t derived_metrics = SE_BME680_METRIC_NONE;
+#endif
+
+    // Mode flags, bit-packed in the packed layout
+#if SE_BME680_ENABLE_SMOOTHING
+    bool donchian_enabled SE_BME680_BITS(1, false);       // Whether Donchian smoothing is enabled for compensated humidity and gas resistance readings used in the IAQ calculation
+    bool exponential_enabled SE_BME680_BITS(1, false);    // Whether exponential (EWMA) smoothing is enabled for the IAQ calculation
+    bool auto_smoothing_enabled SE_BME680_BITS(1, false); // Whether the smoothing period is sized automatically from the detected oscillation period of temperature and humidity
+#endif
+#if SE_BME680_ENABLE_IAQ
+    bool gas_spike_filter_enabled SE_BME680_BITS(1, false); // Whether the Hampel spike filter is applied to gas resistance readings before the IAQ calculation
+#endif
+    bool lazy_enabled SE_BME680_BITS(1, false); // Whether derived outputs (dew point, compensated humidity and IAQ score) are computed on first access instead of in every reading
+
+    // Set by a reading when the corresponding derived output has not been computed yet in lazy mode
+#if SE_BME680_ENABLE_DEW_POINT
+    bool dew_point_dirty SE_BME680_BITS(1, false);
+#endif
+    bool humidity_compensated_dirty SE_BME680_BITS(1, false);
+#if SE_BME680_ENABLE_IAQ
+    bool IAQ_dirty SE_BME680_BITS(1, false);
+#endif
+
+#if SE_BME680_ENABLE_DEW_POINT
+    /*!
+    *  @brief  Calculate the dew point from the raw temperature and humidity
+    */
+    void calculateDewPoint();
+#endif
+
+    /*!
+    *  @brief  Calculate the compensated humidity from the raw humidity and the temperature offset
+    */
+    void calculateCompensatedHumidity();
+
+#if SE_BME680_ENABLE_DERIVED_METRICS
+    /*!
+    *  @brief  Calculate the selected extended metrics from the compensated temperature and humidity
+    *  @param  vaporPressure
+    *          Actual water vapor pressure in hPa, as computed for the humidity compensation
+    */
+    void calculateDerivedMetrics(float vaporPressure);
+#endif
+
+#if SE_BME680_ENABLE_SMOOTHING
+    /*!
+    *  @brief  Get the memory currently holding the Donchian data arrays
+    *  @return Storage, or nullptr if Donchian smoothing is disabled
+    */
+    const float* smoothingStorage() const;
+
+    /*!
+    *  @brief  Get the size of the Donchian data arrays of all three channels
+    *  @param  channel
+    *          Samples per channel, from storageSamples()
+    *  @return Number of floats, or -1 if the size cannot be represented
+    */
+    static long smoothingFloats(long channel);
+
+    /*!
+    *  @brief  Get storage for the Donchian data arrays, reusing the current memory when it is large enough
+    *  @param  floats
+    *          Number of floats needed
+    *  @return Storage, or nullptr if the arena or pool is too small
+    */
+    float* acquireSmoothingStorage(int floats);
+
+    /*!
+    *  @brief  Detach the Donchian data arrays and free the heap block, if any
+    */
+    void releaseSmoothingStorage();
+
+    /*!
+    *  @brief  Track the oscillation period of temperature and humidity, and resize the smoothing period when a confident period is detected
+    */
+    void updateSmoothingPeriod();
+#endif
+
+    /*!
+    *  @brief  Copy the configuration and all tracking state of another core, giving this core its own copy of the smoothing history
+    */
+    void copyFrom(const IAQCoreT& other);
+
+#if SE_BME680_ENABLE_IAQ
+    /*!
+    *  @brief  Calculate the Indoor Air Quality (IAQ) based on the compensated gas resistance and the ongoing average gas ceiling
+    *  @param  now
+    *          Timestamp of the reading in milliseconds
+    *  @param  gas_resistance
+    *          Raw gas resistance in ohms
+    */
+    void calculateIAQ(unsigned long now, uint32_t gas_resistance);
+#endif
+
+  public:
+
+#if SE_BME680_ENABLE_IAQ
+    // Estimated accuracy of the current IAQ reading: 0 = unreliable, 1 = low accuracy, 2 = moderate accuracy, 3 = high accuracy, 4 = very high accuracy
+    int IAQ_accuracy SE_BME680_BITS(4, 0); // A 4-bit field in the packed layout, so it cannot be bound to a reference or pointer there
+
+    // Indor Air Quality (0-100%, bad to good), assigned by process()
+    float IAQ = 50.0F; // Default to 50% (neutral air quality) while accuracy is 0, which is the default "unreliable" accuracy level before any readings are taken
+#endif
+
+#if SE_BME680_ENABLE_DEW_POINT
+    // Dew point (Celsius) based on temperature and humidity, assigned by process().
+    // Note that the dew point is the same regardless of whether raw or compensated temperature and humidity are used since both dew point calculation and humidity compensation use the same Magnus transformations.
+    float dew_point;
+#endif
+
+    // Compensated temperature (Celsius), assigned by process()
+    float temperature_compensated;
+
+    // Compensated humidity (RH %), assigned by process()
+    float humidity_compensated;
+
+#if SE_BME680_ENABLE_DEW_POINT
+    // NOTE: This ends up being the same as the "raw" dew point value since both dew point calculation and humidity compensation use the same Magnus transformations
+    // Dew point (Celsius) based on compensated temperature and humidity, assigned by process()
+    //float dew_point_compensated;
+#endif
+
+#if SE_BME680_ENABLE_DERIVED_METRICS
+    // Extended derived metrics, assigned by process() if selected with setDerivedMetrics()
+    float absolute_humidity = NAN;  // Absolute humidity (g/m^3)
+    float heat_index = NAN;         // Heat index (Celsius), the apparent temperature according to the NOAA regression
+    float humidex = NAN;            // Humidex (Celsius), the apparent temperature according to Environment Canada
+    float mixing_ratio = NAN;       // Mixing ratio (g of water vapor per kg of dry air)
+    float pressure_sea_level = NAN; // Pressure reduced to sea level (hPa), using the station altitude
+    float altitude = NAN;           // Altitude (meters) estimated from the pressure and the sea-level reference pressure
+#endif
+
+    /*!
+    *  @brief  Construct with the default configuration, with gas calibration starting at timestamp zero
+    */
+    IAQCoreT();
+
+    /*!
+    *  @brief  Copy constructor. The copy is a complete checkpoint of the pipeline (configuration, calibration, filters and smoothing history) and
+    *          continues exactly as the original would from that point. Smoothing history in a caller-supplied buffer is copied to the pool or the heap
+    *          (Donchian smoothing is disabled in the copy if it does not fit in the pool).
+    */
+    IAQCoreT(const IAQCoreT& other);
+
+    /*!
+    *  @brief  Copy assignment, with the same semantics as the copy constructor
+    */
+    IAQCoreT& operator=(const IAQCoreT& other);
+
+    /*!
+    *  @brief  Destructor, releasing smoothing memory taken from the heap
+    */
+    ~IAQCoreT();
+
+    /*!
+    *  @brief  Process one reading: compensate temperature and humidity, compute the dew point and the selected derived metrics (or defer them in lazy mode),
+    *          and advance smoothing, gas calibration and the IAQ score. Readings must be passed in the order they were taken, at the polling interval
+    *          the calibration timings and smoothing periods are designed for.
+    *  @param  timestamp
+    *          Time of the reading in milliseconds, e.g. millis() on the sensor board or a per-device clock in a gateway. Only differences are used, so any
+    *          origin works as long as it is the same one passed to resetCalibration() and reset(), and wraparound is handled like millis().
+    *  @param  temperature
+    *          Raw temperature in degrees Celsius
+    *  @param  humidity
+    *          Raw relative humidity in RH %
+    *  @param  pressure
+    *          Pressure in Pa, only used for the derived metrics
+    *  @param  gas_resistance
+    *          Raw gas resistance in ohms, only used for the IAQ calculation
+    */
+    void process(unsigned long timestamp, float temperature, float humidity, float pressure, uint32_t gas_resistance);
+
+    /*!
+    *  @brief  Set temperature compensation in degrees Celsius
+    *  @param  degreesC
+    *          Temperature offset in degrees Celsius to be added to the raw temperature reading and used to compensate humidity and dew point calculations
+    */
+    void setTemperatureCompensation(float degreesC) { temperature_offset = degreesC; }
+
+    /*!
+    *  @brief  Set temperature compensation in degrees Fahrenheit
+    *  @param  degreesF
+    *          Temperature offset in degrees Fahrenheit to be added to the raw temperature reading and used to compensate humidity and dew point calculations
+    */
+    void setTemperatureCompensationF(float degreesF) { setTemperatureCompensation(degreesF * 5.0F / 9.0F); } // Convert Fahrenheit to Celsius
+
+#if SE_BME680_ENABLE_SMOOTHING
+    /*!
+    *  @brief  Enable or disable Donchian smoothing for the IAQ calculation. Should be called before processing any readings.
+    *          Calling it again reconfigures smoothing in place, reusing the current memory when the new periods fit, and disabling it releases the memory.
+    *  @param  enabled
+    *          True to enable Donchian smoothing, false to disable it
+    *  @param  periods
+    *          Number of periods to use for Donchian smoothing (at least 2, likely 200 or so). This is the number of samples to consider for the min/max range in the smoothing calculation.
+    *          A value should be selected that compensates for observed oscillations in humidity readings due to the cycling of air conditioners, heaters, etc.
+    *  @return True if smoothing was configured successfully, false if the parameters are invalid, the smoothing buffer or pool is too small,
+    *          or the history needs more floats than an int can count
+    */
+    bool setDonchianSmoothing(bool enabled, int periods = 200, float temperatureRangeLimitMax = 0.0F, float humidityRangeLimitMax = 0.0F, float gasResistanceRangeLimitMax = 0.0F);
+
+    /*!
+    *  @brief  Supply the memory for Donchian smoothing instead of using the heap (or the embedded pool, see SE_BME680_SMOOTHING_POOL_SIZE).
+    *          Smoothing needs three floats per period, or one and a half with SE_BME680_QUANTIZED_SMOOTHING.
+    *          With SE_BME680_DONCHIAN_BLOCK_SIZE, it needs twelve floats (or six) per block instead. The memory must stay valid while smoothing is enabled. Call before setDonchianSmoothing().
+    *  @param  buffer
+    *          Caller-supplied memory, e.g. a static array, or nullptr to go back to the pool or the heap
+    *  @param  floats
+    *          Size of the memory in floats
+    *  @return True if the buffer was accepted, false if the parameters are invalid
+    */
+    bool setSmoothingBuffer(float* buffer, int floats);
+
+    /*!
+    *  @brief  Enable or disable exponential (EWMA) smoothing for the IAQ calculation. Uses constant memory and replaces Donchian smoothing if it was enabled.
+    *  @param  enabled
+    *          True to enable exponential smoothing, false to disable it
+    *  @param  periods
+    *          Time constant in samples (at least 2). The smoothing factor is 2 / (periods + 1), which lags about as much as Donchian smoothing with the same number of periods.
+    *  @param  fastPeriods
+    *          Time constant in samples for an optional fast average used for breakout detection, or zero for a single average.
+    *          When the fast average moves further than the range limit away from the slow average, the slow average follows it.
+    *  @return True if smoothing was configured successfully, false if the parameters are invalid (periods below 2, or fastPeriods negative or not below periods)
+    */
+    bool setExponentialSmoothing(bool enabled, int periods = 200, int fastPeriods = 0, float temperatureRangeLimitMax = 0.0F, float humidityRangeLimitMax = 0.0F, float gasResistanceRangeLimitMax = 0.0F);
+  
+    /*!
+    *  @brief  Enable or disable automatic selection of the smoothing period. The dominant oscillation period of the raw temperature and humidity readings
+    *          (e.g. the cycle of an air conditioner) is detected continuously, and the smoothing period is set to one detected cycle plus 10%.
+    *          Donchian or exponential smoothing must also be enabled. For Donchian smoothing, the periods passed to setDonchianSmoothing() are the largest window available.
+    *  @param  enabled
+    *          True to enable automatic period selection, false to keep the current smoothing period from now on
+    *  @param  minPeriods
+    *          Shortest oscillation period to detect, in samples (at least 4)
+    *  @param  maxPeriods
+    *          Longest oscillation period to detect, in samples. Detection starts after twice this many samples.
+    *  @param  minConfidence
+    *          Minimum detection confidence (0-1) before the smoothing period is changed
+    *  @return True if automatic period selection was configured successfully, false if the parameters are invalid
+    */
+    bool setAutoSmoothingPeriod(bool enabled, int minPeriods = 20, int maxPeriods = 1000, float minConfidence = 0.35F);
+
+    /*!
+    *  @brief Get the detected oscillation period of temperature and humidity
+    *  @return Period in samples, or zero if automatic period selection is disabled or no period has been detected yet
+    */
+    float getDetectedOscillationPeriod(void) { return auto_smoothing_enabled ? oscillation_detector.period : 0.0F; }
+
+    /*!
+    *  @brief Get the confidence of the detected oscillation period
+    *  @return Share of the total spectral power at the detected period (0-1, higher is better)
+    */
+    float getDetectedOscillationConfidence(void) { return auto_smoothing_enabled ? oscillation_detector.confidence : 0.0F; }
+
+    /*!
+    *  @brief Get the current smoothing period, which changes over time when automatic period selection is enabled
+    *  @return Smoothing period in samples, or zero if smoothing is disabled
+    */
+    int getSmoothingPeriods(void) { return (donchian_enabled || exponential_enabled) ? smoothing_periods : 0; }
+#endif
+
+#if SE_BME680_ENABLE_IAQ
+    /*!
+    *  @brief  Enable or disable the Hampel spike filter for gas resistance. Outliers are replaced by the median of the recent readings before they reach
+    *          smoothing and gas calibration, so single-sample spikes cannot widen the Donchian channels or inflate the gas ceiling.
+    *  @param  enabled
+    *          True to enable the spike filter, false to disable it
+    *  @param  window
+    *          Number of recent readings to compare against (3 to HAMPEL_WINDOW_MAX, default 7)
+    *  @param  threshold
+    *          Number of scaled median absolute deviations a reading may differ from the median before it is rejected (default 3)
+    *  @return True if the filter was configured successfully, false if the parameters are invalid
+    */
+    bool setGasSpikeFilter(bool enabled, int window = 7, float threshold = 3.0F);
+
+    /*!
+    *  @brief Get the number of gas resistance readings rejected by the spike filter since it was enabled or its history was last cleared by resetSmoothing() or reset()
+    *  @return Number of rejected readings
+    */
+    unsigned long getGasSpikeCount(void) { return gas_spike_filter.rejected; }
+#endif
+
+    /*!
+    *  @brief  Enable or disable lazy evaluation of derived outputs. When enabled, the dew point, compensated humidity and IAQ score are only computed
+    *          when they are first accessed through getDewPoint(), getCompensatedHumidity() or getIAQ() after a reading, and are then cached until the next reading.
+    *          The dew_point, humidity_compensated and IAQ properties are only refreshed by those accessors in lazy mode.
+    *          Gas calibration, smoothing and the IAQ accuracy still advance on every reading to keep their timing.
+    *  @param  enabled
+    *          True to compute derived outputs on first access, false to compute them in every reading (default)
+    */
+    void setLazyEvaluation(bool enabled);
+
+#if SE_BME680_ENABLE_DEW_POINT
+    /*!
+    *  @brief Get the dew point of the last reading, computing it first if needed
+    *  @return Dew point in degrees Celsius
+    */
+    float getDewPoint(void);
+#endif
+
+    /*!
+    *  @brief Get the compensated temperature of the last reading
+    *  @return Compensated temperature in degrees Celsius
+    */
+    float getCompensatedTemperature(void) { return temperature_compensated; }
+
+    /*!
+    *  @brief Get the compensated humidity of the last reading, computing it first if needed
+    *  @return Compensated humidity in percentage (0-100)
+    */
+    float getCompensatedHumidity(void);
+
+#if SE_BME680_ENABLE_DERIVED_METRICS
+    /*!
+    *  @brief  Select the extended derived metrics to compute in each reading. They share the vapor pressure computed for the humidity compensation,
+    *          and metrics that are not selected cost nothing. Unselected metrics keep their last value (NAN initially).
+    *  @param  metrics
+    *          Combination of SE_BME680_METRIC_* flags, e.g. SE_BME680_METRIC_ABSOLUTE_HUMIDITY | SE_BME680_METRIC_HEAT_INDEX
+    */
+    void setDerivedMetrics(uint8_t metrics) { derived_metrics = metrics & SE_BME680_METRIC_ALL; }
+
+    /*!
+    *  @brief  Set the altitude of the sensor, used to reduce the measured pressure to sea level
+    *  @param  meters
+    *          Altitude above sea level in meters (-500 to 9000)
+    *  @return True if the altitude was set successfully, false if it is out of range
+    */
+    bool setStationAltitude(float meters);
+
+    /*!
+    *  @brief  Set the sea-level reference pressure used for the altitude calculation
+    *  @param  hPa
+    *          Current sea-level pressure in hPa, e.g. from a nearby weather station (default 1013.25)
+    *  @return True if the pressure was set successfully, false if it is out of range
+    */
+    bool setAltitudeReferencePressure(float hPa);
+
+    /*!
+    *  @brief Get the absolute humidity of the last reading, computing it first if needed
+    *  @return Absolute humidity in g/m^3
+    */
+    float getAbsoluteHumidity(void) { getCompensatedHumidity(); return absolute_humidity; }
+
+    /*!
+    *  @brief Get the heat index of the last reading, computing it first if needed
+    *  @return Heat index in degrees Celsius
+    */
+    float getHeatIndex(void) { getCompensatedHumidity(); return heat_index; }
+
+    /*!
+    *  @brief Get the humidex of the last reading, computing it first if needed
+    *  @return Humidex in degrees Celsius
+    */
+    float getHumidex(void) { getCompensatedHumidity(); return humidex; }
+
+    /*!
+    *  @brief Get the mixing ratio of the last reading, computing it first if needed
+    *  @return Mixing ratio in g/kg
+    */
+    float getMixingRatio(void) { getCompensatedHumidity(); return mixing_ratio; }
+
+    /*!
+    *  @brief Get the sea-level pressure of the last reading, computing it first if needed
+    *  @return Sea-level pressure in hPa
+    */
+    float getSeaLevelPressure(void) { getCompensatedHumidity(); return pressure_sea_level; }
+
+    /*!
+    *  @brief Get the altitude estimated from the last reading, computing it first if needed
+    *  @return Altitude in meters
+    */
+    float getAltitude(void) { getCompensatedHumidity(); return altitude; }
+#endif
+
+#if SE_BME680_ENABLE_IAQ
+    /*!
+    *  @brief Get the Indoor Air Quality (IAQ) of the last reading, computing the score first if needed
+    *  @return IAQ value (0-100%, where 0% is bad air quality and 100% is good air quality)
+    */
+    float getIAQ(void);
+#endif
+
+
+#if SE_BME680_ENABLE_IAQ
+    /*!
+    *  @brief Get the estimated accuracy of the IAQ reading
+    *  @return 0 = unreliable, 1 = low accuracy, 2 = moderate accuracy, 3 = high accuracy, 4 = very high accuracy
+    */
+    int getIAQAccuracy(void) { return IAQ_accuracy; }
+
+    /*!
+    *  @brief Get the current gas calibration stage
+    *  @details The gas calibration stages are:
+    *           0 = Initialization stage (first 30 seconds), where gas resistance is not stable yet and no gas calibration data is collected
+    *           1 = Burn-in stage (first 5 minutes), where gas resistance is expected to be moderately stable and a low accuracy IAQ can be calculated
+    *           2 = Normal operation stage (after first 5 minutes)
+    */
+    int getGasCalibrationStage(void) { return gas_ceiling_estimator.getStage(); }
+
+    /*!
+    *  @brief Get the current accuracy of gas calibration as a percentage. The higher the cailbration accuracy, the more stable the IAQ calculation is.
+    *  @return Current accuracy as a percentage (0-100%, bad to good)
+    */
+    float getGasCalibrationAccuracy(void) { return (1.0F - gas_ceiling_estimator.getRange()) * 100.0F; } // Invert the rage percentage to get accuracy percentage
+  
+    /*!
+    *  @brief Set gas resistance compensation slope factor
+    *  @param slopeFactor
+    *         The slope factor for the linear compensation of the logarithmic gas resistance by the present humidity (default 0.03)
+    */
+    bool setGasCompensationSlopeFactor(double slopeFactor = 0.03);
+
+    /*!
+    *  @brief Set the lower and upper "high" gas resistance limits for gas calibration
+    *  @param minLimit
+    *         The minimum gas resistance limit (in ohms) for gas ceiling calibration. High readings below this threshold are rounded up to it.
+    *  @param maxLimit
+    *         The maximum gas resistance limit (in ohms) above which gas readings are ignored for gas ceiling calibration
+    */
+    bool setUpperGasResistanceLimits(uint32_t minLimit = 30000, uint32_t maxLimit = 225000);
+
+    /*!
+    *  @brief Set minimum timings for gas calibration stages. Each stage may take longer depending on the polling frequency and the environment.
+    *  @param initTime
+    *         Minimum time in milliseconds for the initialization stage (default 30 seconds at 1-second polling frequency)
+    *  @param burninTime
+    *         Minimum time in milliseconds for the burn-in stage (default 5 minutes at 1-second polling frequency)
+    *  @param decayTime
+    *         Decay time interval in milliseconds (default 30 minutes at 1-second polling frequency)
+    * @return True if the timings were set successfully, false if the timings are invalid
+    *         (e.g., if initTime is not less than burninTime, or burninTime is not less than decayTime)
+    */
+    bool setGasCalibrationTimings(int initTime = 30 * 1000, int burninTime = 5 * 60 * 1000, int decayTime = 30 * 60 * 1000);
+
+    /*!
+    *  @brief Restart gas calibration from the initialization stage, e.g. after the sensor was moved to a different room. IAQ returns to 50% with accuracy 0.
+    *         Configuration (timings, limits, slope factor) is kept.
+    *  @param now
+    *         Timestamp in milliseconds from which the calibration stage timings are measured, on the same clock as process()
+    */
+    void resetCalibration(unsigned long now);
+
+    /*!
+    *  @brief Discard the history of the gas spike filter, Donchian or exponential smoothing and the oscillation detector, keeping their configuration and memory.
+    *         The current smoothing period, including one selected automatically, is kept until a new period is detected.
+    */
+    void resetSmoothing(void);
+
+    /*!
+    *  @brief Calibration state of the core in a fixed layout without pointers, e.g. for keeping calibrations across restarts of a gateway.
+    *         Includes the gas ceiling estimator (calibration data, stage, timer and uptime), the exponential smoothing averages and the IAQ outputs.
+    *         Donchian histories and the spike filter window are not included, since they refill within one smoothing window.
+    */
+    struct State
+    {
+      typename IAQPolicy::Ceiling gas_ceiling_estimator;
+#if SE_BME680_ENABLE_SMOOTHING
+      ExponentialAverage temperature_exponential;
+      ExponentialAverage humidity_exponential;
+      ExponentialAverage gas_resistance_exponential;
+#endif
+      float IAQ;
+      int IAQ_accuracy;
+    };
+
+    /*!
+    *  @brief Copy the calibration state into a State block, evaluating a pending lazy score first
+    *  @param state
+    *         Destination, e.g. a record in a memory-mapped file
+    */
+    void saveState(State& state);
+
+    /*!
+    *  @brief Resume from a State block saved by saveState(). Configuration (timings, limits, slope factor, smoothing periods) is kept, so the same
+    *         configuration should be applied before restoring. Exponential averages are only restored while exponential smoothing is enabled.
+    *         Timestamps in the state are on the clock passed to process() when it was saved, so that clock must continue across restarts.
+    *  @param state
+    *         Source, e.g. a record in a memory-mapped file
+    */
+    void restoreState(const State& state);
+#endif
+
+    /*!
+    *  @brief Reset all tracking state in place (gas calibration, spike filter and smoothing), as if the object had just been constructed with the current configuration.
+    *         Memory is reused.
+    *  @param now
+    *         Timestamp in milliseconds from which the calibration stage timings are measured, on the same clock as process()
+    */
+    void reset(unsigned long now);
+};
+
+// Core using the original IAQ strategies
+typedef IAQCoreT<> IAQCore;
+
+#include <IAQCore_impl.h>
+
+#endif
@@ -0,0 +1,728 @@
+/**
+ * @file  IAQCore_impl.h
+ * @brief Implementation of the IAQCoreT class template, included by IAQCore.h
+ */
+
+#ifndef __IAQ_CORE_IMPL_H__
+#define __IAQ_CORE_IMPL_H__
+
+// IAQ core constructor
+template <class IAQPolicy>
+IAQCoreT<IAQPolicy>::IAQCoreT()
+{
+#if SE_BME680_PACKED_LAYOUT
+  // Bit fields have no default member initializers
+#if SE_BME680_ENABLE_SMOOTHING
+  donchian_enabled = false;
+  exponential_enabled = false;
+  auto_smoothing_enabled = false;
+#endif
+#if SE_BME680_ENABLE_IAQ
+  gas_spike_filter_enabled = false;
+#endif
+  lazy_enabled = false;
+#if SE_BME680_ENABLE_DEW_POINT
+  dew_point_dirty = false;
+#endif
+  humidity_compensated_dirty = false;
+#endif
+
+#if SE_BME680_ENABLE_SMOOTHING && SE_BME680_QUANTIZED_SMOOTHING
+  // Ranges of the 16-bit Donchian histories: the operating range of the BME680 for temperature and humidity, the default log range for gas resistance
+  temperature_donchian.storage.setRange(-40.0F, 85.0F);
+  humidity_donchian.storage.setRange(0.0F, 100.0F);
+#endif
+
+#if SE_BME680_ENABLE_IAQ
+  resetCalibration(0);
+#endif
+}
+
+// IAQ core copy constructor
+template <class IAQPolicy>
+IAQCoreT<IAQPolicy>::IAQCoreT(const IAQCoreT& other)
+{
+  copyFrom(other);
+}
+
+// IAQ core copy assignment
+template <class IAQPolicy>
+IAQCoreT<IAQPolicy>& IAQCoreT<IAQPolicy>::operator=(const IAQCoreT& other)
+{
+  if (this != &other) copyFrom(other);
+  return *this;
+}
+
+// Copy the configuration and all tracking state of another core. Every data member must be listed here.
+template <class IAQPolicy>
+void IAQCoreT<IAQPolicy>::copyFrom(const IAQCoreT& other)
+{
+#if SE_BME680_ENABLE_SMOOTHING
+  // Donchian histories go into storage owned by this core, never into the other core's arena
+  releaseSmoothingStorage();
+  smoothing_arena = nullptr;
+  smoothing_arena_size = 0;
+  DonchianSample* samples = nullptr;
+  long channel = 0;
+  if (other.donchian_enabled)
+  {
+    // Same layout and size check as setDonchianSmoothing(), sized from the storage the other core attached
+    channel = other.temperature_donchian.getStorageSamples();
+    long floats = smoothingFloats(channel);
+    float* storage = floats >= 0 ? acquireSmoothingStorage((int)floats) : nullptr;
+    if (storage != nullptr)
+    {
+      memcpy(storage, other.smoothingStorage(), (size_t)floats * sizeof(float));
+      samples = reinterpret_cast<DonchianSample*>(storage);
+    }
+  }
+  temperature_donchian = other.temperature_donchian;
+  humidity_donchian = other.humidity_donchian;
+  gas_resistance_donchian = other.gas_resistance_donchian;
+  if (samples != nullptr)
+  {
+    temperature_donchian.relocate(samples);
+    humidity_donchian.relocate(samples + channel);
+    gas_resistance_donchian.relocate(samples + 2 * channel);
+  }
+  else
+  {
+    // Donchian smoothing is disabled, or the history does not fit in the embedded pool
+    temperature_donchian.detach();
+    humidity_donchian.detach();
+    gas_resistance_donchian.detach();
+  }
+  auto_smoothing_confidence = other.auto_smoothing_confidence;
+  oscillation_detector = other.oscillation_detector;
+  temperature_exponential = other.temperature_exponential;
+  humidity_exponential = other.humidity_exponential;
+  gas_resistance_exponential = other.gas_resistance_exponential;
+  smoothing_periods = other.smoothing_periods;
+  smoothing_fast_periods = other.smoothing_fast_periods;
+  donchian_enabled = samples != nullptr;
+  exponential_enabled = other.exponential_enabled;
+  auto_smoothing_enabled = other.auto_smoothing_enabled;
+#endif
+
+#if SE_BME680_ENABLE_IAQ
+  gas_spike_filter = other.gas_spike_filter;
+  gas_resistance_limit_min = other.gas_resistance_limit_min;
+  gas_resistance_limit_max = other.gas_resistance_limit_max;
+  iaq_pending_compensated_gas_r = other.iaq_pending_compensated_gas_r;
+  iaq_pending_gas_ceiling = other.iaq_pending_gas_ceiling;
+  gas_compensation = other.gas_compensation;
+  gas_ceiling_estimator = other.gas_ceiling_estimator;
+  gas_spike_filter_enabled = other.gas_spike_filter_enabled;
+  IAQ_dirty = other.IAQ_dirty;
+  IAQ_accuracy = other.IAQ_accuracy;
+  IAQ = other.IAQ;
+#endif
+
+#if SE_BME680_ENABLE_DERIVED_METRICS
+  sea_level_pressure_factor = other.sea_level_pressure_factor;
+  altitude_reference_pressure = other.altitude_reference_pressure;
+  input_pressure = other.input_pressure;
+  derived_metrics = other.derived_metrics;
+  absolute_humidity = other.absolute_humidity;
+  heat_index = other.heat_index;
+  humidex = other.humidex;
+  mixing_ratio = other.mixing_ratio;
+  pressure_sea_level = other.pressure_sea_level;
+  altitude = other.altitude;
+#endif
+
+#if SE_BME680_ENABLE_DEW_POINT
+  dew_point_dirty = other.dew_point_dirty;
+  dew_point = other.dew_point;
+#endif
+  temperature_offset = other.temperature_offset;
+  input_temperature = other.input_temperature;
+  input_humidity = other.input_humidity;
+  lazy_enabled = other.lazy_enabled;
+  humidity_compensated_dirty = other.humidity_compensated_dirty;
+  temperature_compensated = other.temperature_compensated;
+  humidity_compensated = other.humidity_compensated;
+}
+
+// IAQ core destructor
+template <class IAQPolicy>
+IAQCoreT<IAQPolicy>::~IAQCoreT()
+{
+#if SE_BME680_ENABLE_SMOOTHING
+  releaseSmoothingStorage();
+#endif
+}
+
+#if SE_BME680_ENABLE_IAQ
+// Restart gas calibration from the initialization stage
+template <class IAQPolicy>
+void IAQCoreT<IAQPolicy>::resetCalibration(unsigned long now)
+{
+  // Reset globals
+  IAQ = 50.0F; // Default to 50% (neutral air quality) while accuracy is 0, which is the default "unreliable" accuracy level before any readings are taken
+  IAQ_accuracy = 0; // Default to unreliable accuracy
+  IAQ_dirty = false; // Discard any pending lazy score
+
+  // Reset the gas ceiling estimator, including the gas calibration timer
+  gas_ceiling_estimator.reset(now);
+}
+
+// Discard the history of the spike filter, smoothing and the oscillation detector
+template <class IAQPolicy>
+void IAQCoreT<IAQPolicy>::resetSmoothing(void)
+{
+  gas_spike_filter.reset();
+#if SE_BME680_ENABLE_SMOOTHING
+  temperature_donchian.reset();
+  humidity_donchian.reset();
+  gas_resistance_donchian.reset();
+  temperature_exponential.reset();
+  humidity_exponential.reset();
+  gas_resistance_exponential.reset();
+  oscillation_detector.reset();
+#endif
+}
+
+// Copy the calibration state into a State block
+template <class IAQPolicy>
+void IAQCoreT<IAQPolicy>::saveState(State& state)
+{
+  state.gas_ceiling_estimator = gas_ceiling_estimator;
+#if SE_BME680_ENABLE_SMOOTHING
+  state.temperature_exponential = temperature_exponential;
+  state.humidity_exponential = humidity_exponential;
+  state.gas_resistance_exponential = gas_resistance_exponential;
+#endif
+  state.IAQ = getIAQ(); // Evaluate a pending lazy score so the saved outputs are current
+  state.IAQ_accuracy = IAQ_accuracy;
+}
+
+// Resume from a State block, keeping the current configuration
+template <class IAQPolicy>
+void IAQCoreT<IAQPolicy>::restoreState(const State& state)
+{
+  gas_ceiling_estimator.resume(state.gas_ceiling_estimator);
+#if SE_BME680_ENABLE_SMOOTHING
+  if (exponential_enabled)
+  {
+    temperature_exponential.resume(state.temperature_exponential);
+    humidity_exponential.resume(state.humidity_exponential);
+    gas_resistance_exponential.resume(state.gas_resistance_exponential);
+  }
+#endif
+  IAQ = state.IAQ;
+  IAQ_accuracy = state.IAQ_accuracy;
+  IAQ_dirty = false;
+}
+#endif
+
+// Reset all tracking state in place
+template <class IAQPolicy>
+void IAQCoreT<IAQPolicy>::reset(unsigned long now)
+{
+#if SE_BME680_ENABLE_IAQ
+  resetCalibration(now);
+  resetSmoothing();
+#else
+  (void)now;
+#endif
+}
+
+#if SE_BME680_ENABLE_SMOOTHING
+// Enable and initialize Donchian smoothing
+template <class IAQPolicy>
+bool IAQCoreT<IAQPolicy>::setDonchianSmoothing(bool enabled, int periods, float temperatureRangeLimitMax, float humidityRangeLimitMax, float gasResistanceRangeLimitMax)
+{
+  if (!enabled)
+  {
+    donchian_enabled = false;
+    releaseSmoothingStorage();
+    return true;
+  }
+  if (periods < 2) return false; // Invalid periods
+  long channel = ClimateDonchian::storageSamples(periods); // Samples per channel
+  long floats = smoothingFloats(channel);
+  if (floats < 0) return false; // Too large to allocate
+
+  // Reuse the current storage if it is large enough
+  float* storage = acquireSmoothingStorage((int)floats);
+  if (storage == nullptr) return false; // Arena or pool too small
+  DonchianSample* samples = reinterpret_cast<DonchianSample*>(storage);
+  exponential_enabled = false; // Only one smoothing mode at a time
+  donchian_enabled = true;
+  temperature_donchian.attach(samples, periods, temperatureRangeLimitMax);
+  humidity_donchian.attach(samples + channel, periods, humidityRangeLimitMax);
+  gas_resistance_donchian.attach(samples + 2 * channel, periods, gasResistanceRangeLimitMax);
+  smoothing_periods = periods;
+  smoothing_fast_periods = 0;
+  return true;
+}
+
+// Supply the memory for Donchian smoothing
+template <class IAQPolicy>
+bool IAQCoreT<IAQPolicy>::setSmoothingBuffer(float* buffer, int floats)
+{
+  if (donchian_enabled) return false; // The data arrays are in use
+  if (buffer != nullptr && floats < 6) return false; // Not even enough for two periods
+  releaseSmoothingStorage();
+  smoothing_arena = buffer;
+  smoothing_arena_size = buffer != nullptr ? floats : 0;
+  return true;
+}
+
+// Get the memory currently holding the Donchian data arrays, with the same precedence as acquireSmoothingStorage()
+template <class IAQPolicy>
+const float* IAQCoreT<IAQPolicy>::smoothingStorage() const
+{
+  if (!donchian_enabled) return nullptr;
+  if (smoothing_arena != nullptr) return smoothing_arena;
+#if SE_BME680_SMOOTHING_POOL_SIZE > 0
+  return smoothing_pool;
+#else
+  return smoothing_heap;
+#endif
+}
+
+// Get the size of the Donchian data arrays of all three channels, in floats since storage is handed out in floats
+template <class IAQPolicy>
+long IAQCoreT<IAQPolicy>::smoothingFloats(long channel)
+{
+  const long sampleBytes = (long)sizeof(DonchianSample);
+  if (channel < 0 || channel > (LONG_MAX - (long)sizeof(float)) / 3 / sampleBytes) return -1; // Byte count overflows a long
+  long floats = (3 * channel * sampleBytes + (long)sizeof(float) - 1) / (long)sizeof(float);
+  return floats <= INT_MAX ? floats : -1; // Storage sizes are ints
+}
+
+// Get storage for the Donchian data arrays, reusing the current memory when it is large enough
+template <class IAQPolicy>
+float* IAQCoreT<IAQPolicy>::acquireSmoothingStorage(int floats)
+{
+  // Caller-supplied arena first
+  if (smoothing_arena != nullptr) return floats <= smoothing_arena_size ? smoothing_arena : nullptr;
+
+#if SE_BME680_SMOOTHING_POOL_SIZE > 0
+  // Embedded pool
+  return floats <= SE_BME680_SMOOTHING_POOL_SIZE ? smoothing_pool : nullptr;
+#else
+  // Heap block, only reallocated when it has to grow
+  if (floats > smoothing_heap_size)
+  {
+    temperature_donchian.detach();
+    humidity_donchian.detach();
+    gas_resistance_donchian.detach();
+    delete[] smoothing_heap;
+    smoothing_heap = new float[floats];
+    smoothing_heap_size = smoothing_heap != nullptr ? floats : 0;
+  }
+  return smoothing_heap;
+#endif
+}
+
+// Detach the Donchian data arrays and free the heap block, if any
+template <class IAQPolicy>
+void IAQCoreT<IAQPolicy>::releaseSmoothingStorage()
+{
+  temperature_donchian.detach();
+  humidity_donchian.detach();
+  gas_resistance_donchian.detach();
+  delete[] smoothing_heap;
+  smoothing_heap = nullptr;
+  smoothing_heap_size = 0;
+}
+
+// Enable and initialize exponential smoothing
+template <class IAQPolicy>
+bool IAQCoreT<IAQPolicy>::setExponentialSmoothing(bool enabled, int periods, int fastPeriods, float temperatureRangeLimitMax, float humidityRangeLimitMax, float gasResistanceRangeLimitMax)
+{
+  if (!enabled)
+  {
+    exponential_enabled = false;
+    return true;
+  }
+  if (periods < 2 || fastPeriods < 0 || fastPeriods >= periods) return false;
+  donchian_enabled = false; // Only one smoothing mode at a time
+  releaseSmoothingStorage();
+  exponential_enabled = true;
+  temperature_exponential.configure(periods, fastPeriods, temperatureRangeLimitMax);
+  humidity_exponential.configure(periods, fastPeriods, humidityRangeLimitMax);
+  gas_resistance_exponential.configure(periods, fastPeriods, gasResistanceRangeLimitMax);
+  smoothing_periods = periods;
+  smoothing_fast_periods = fastPeriods;
+  return true;
+}
+
+// Enable and configure automatic smoothing period selection
+template <class IAQPolicy>
+bool IAQCoreT<IAQPolicy>::setAutoSmoothingPeriod(bool enabled, int minPeriods, int maxPeriods, float minConfidence)
+{
+  if (!enabled)
+  {
+    auto_smoothing_enabled = false;
+    return true;
+  }
+  if (minConfidence <= 0.0F || minConfidence > 1.0F) return false; // Invalid confidence
+  if (!oscillation_detector.configure(minPeriods, maxPeriods)) return false; // Invalid period range
+  auto_smoothing_confidence = minConfidence;
+  auto_smoothing_enabled = true;
+  return true;
+}
+
+// Track the oscillation period of temperature and humidity, and resize the smoothing period when a confident period is detected
+template <class IAQPolicy>
+void IAQCoreT<IAQPolicy>::updateSmoothingPeriod()
+{
+  // Humidity is the primary channel since its oscillations have the largest impact on IAQ
+  oscillation_detector.track(input_humidity, input_temperature);
+  if (oscillation_detector.period <= 0.0F || oscillation_detector.confidence < auto_smoothing_confidence) return; // No confident period yet
+
+  // Size the smoothing period to one detected cycle plus 10%, ignoring changes of less than 10% to avoid constant resizing
+  int periods = (int)(oscillation_detector.period * 1.1F + 0.5F);
+  if (periods < 2) periods = 2;
+  int change = periods - smoothing_periods;
+  if (change < 0) change = -change;
+  if (change * 10 <= smoothing_periods) return;
+
+  if (donchian_enabled)
+  {
+    // Resize the lookback within the allocated data arrays
+    temperature_donchian.setWindow(periods);
+    humidity_donchian.setWindow(periods);
+    gas_resistance_donchian.setWindow(periods);
+    periods = humidity_donchian.getWindow(); // The window may have been limited by the size of the data arrays
+  }
+  else if (exponential_enabled)
+  {
+    // Keep the ratio between the slow and fast periods
+    int fastPeriods = smoothing_fast_periods > 0 ? (int)((long)smoothing_fast_periods * periods / smoothing_periods) : 0;
+    if (smoothing_fast_periods > 0 && fastPeriods < 1) fastPeriods = 1;
+    temperature_exponential.setPeriods(periods, fastPeriods);
+    humidity_exponential.setPeriods(periods, fastPeriods);
+    gas_resistance_exponential.setPeriods(periods, fastPeriods);
+    smoothing_fast_periods = fastPeriods;
+  }
+  else
+  {
+    return; // No smoothing enabled
+  }
+  smoothing_periods = periods;
+}
+#endif
+
+#if SE_BME680_ENABLE_IAQ
+// Enable and configure the gas resistance spike filter
+template <class IAQPolicy>
+bool IAQCoreT<IAQPolicy>::setGasSpikeFilter(bool enabled, int window, float threshold)
+{
+  if (!enabled)
+  {
+    gas_spike_filter_enabled = false;
+    return true;
+  }
+  if (!gas_spike_filter.configure(window, threshold)) return false; // Invalid parameters
+  gas_spike_filter_enabled = true;
+  return true;
+}
+
+// Calculate the Indoor Air Quality (IAQ) based on the compensated gas resistance and the ongoing average gas ceiling
+// References and credits for the IAQ calculation:
+//   https://github.com/thstielow/raspi-bme680-iaq
+//   https://forums.pimoroni.com/t/bme680-observed-gas-ohms-readings/6608/18
+template <class IAQPolicy>
+void IAQCoreT<IAQPolicy>::calculateIAQ(unsigned long now, uint32_t gas_resistance)
+{
+#if SE_BME680_ENABLE_SMOOTHING
+  // Track temperature and humidity oscillations on every reading, including readings with spurious gas values, so the detected period stays in samples
+  if (auto_smoothing_enabled)
+  {
+    updateSmoothingPeriod();
+  }
+#endif
+
+  // Ignore spurious gas readings. Documented range is 50-50k ohms, typical. Note that ignoring high readings may increase stabilization time.
+  if (gas_resistance > gas_resistance_limit_max)
+  {
+    gas_ceiling_estimator.rejectReading(1000); // Add 1 second to the calibration timer to allow more time to stabilize
+    return;
+  }
+
+  // Replace single-sample gas resistance spikes with the recent median, if enabled
+  uint32_t gas_resistance_filtered = gas_resistance; // Raw gas resistance reading
+  if (gas_spike_filter_enabled)
+  {
+    gas_resistance_filtered = (uint32_t)round(gas_spike_filter.filter((float)gas_resistance));
+  }
+
+  // Smooth some readings using Donchian or exponential smoothing, if enabled
+  float temperature_smoothed = input_temperature; // Raw temperature reading
+  float humidity_smoothed = input_humidity; // Raw humidity reading
+  uint32_t gas_resistance_smoothed = gas_resistance_filtered; // Raw or spike filtered gas resistance reading
+#if SE_BME680_ENABLE_SMOOTHING
+  if (donchian_enabled && gas_ceiling_estimator.getStage() >= 1) // Donchian smoothing is only applied after the initialization stage has finished to avoid spurious gas readings inflating the Donchian min/max range
+  {
+    // Track the current raw readings
+    temperature_donchian.track(input_temperature);
+    humidity_donchian.track(input_humidity);
+    gas_resistance_donchian.track((float)gas_resistance_filtered);
+
+    // Use the smoothed values
+    temperature_smoothed = temperature_donchian.average;
+    humidity_smoothed = humidity_donchian.average;
+    gas_resistance_smoothed = (uint32_t)round(gas_resistance_donchian.average);
+  }
+  else if (exponential_enabled && gas_ceiling_estimator.getStage() >= 1) // Same as above, exponential smoothing starts after the initialization stage
+  {
+    // Track the current raw readings
+    temperature_exponential.track(input_temperature);
+    humidity_exponential.track(input_humidity);
+    gas_resistance_exponential.track((float)gas_resistance_filtered);
+
+    // Use the smoothed values
+    temperature_smoothed = temperature_exponential.average;
+    humidity_smoothed = humidity_exponential.average;
+    gas_resistance_smoothed = (uint32_t)round(gas_resistance_exponential.average);
+  }
+#endif
+
+  // Compensate exponential impact of humidity on resistance
+  double factor = gas_compensation.factor(temperature_smoothed, humidity_smoothed); // Exponential factor based on humidity
+  double compensated_gas_r = (double)gas_resistance_smoothed * factor; // Compensated gas resistance based on the humidity factor
+  double compensated_gas_r_min = (double)gas_resistance_limit_min * factor; // Compensated minimum gas resistance limit based on the humidity factor, important if the sensor is started in a low air quality environment
+  if (isnan(compensated_gas_r) || isnan(compensated_gas_r_min)) return;
+
+  // Update gas calibration data with the compensated gas resistance value
+  gas_ceiling_estimator.update(now, gas_resistance_filtered, compensated_gas_r, compensated_gas_r_min);
+
+  // Calculate IAQ based on compensated gas resistance and the ongoing average gas ceiling
+  double gas_ceiling = gas_ceiling_estimator.getCeiling();
+  if (gas_ceiling)
+  {
+    if (lazy_enabled)
+    {
+      // Defer the score until it is accessed
+      iaq_pending_compensated_gas_r = compensated_gas_r;
+      iaq_pending_gas_ceiling = gas_ceiling;
+      IAQ_dirty = true;
+    }
+    else
+    {
+      IAQ = Scoring::score(compensated_gas_r, gas_ceiling);
+    }
+  }
+
+  // Estimate IAQ calculation accuracy based on gas calibration timing stage, calibration data range and sensor uptime
+  IAQ_accuracy = gas_ceiling_estimator.getAccuracy();
+}
+#endif
+
+#if SE_BME680_ENABLE_DEW_POINT
+// Calculate the dew point from the raw temperature and humidity
+template <class IAQPolicy>
+void IAQCoreT<IAQPolicy>::calculateDewPoint(void)
+{
+  // Dew point calculation using raw measurements and the Magnus formula: https://en.wikipedia.org/wiki/Dew_point#Calculating_the_dew_point
+  float magnusGammaTRH = (float)log(input_humidity / 100.0F) + 17.625F * input_temperature / (243.04F + input_temperature);
+  dew_point = 243.04F * magnusGammaTRH / (17.625F - magnusGammaTRH); // Celsius
+
+  // NOTE: A compensated dew point ends up being identical to the dew point value calculated above since both dew point calculation and humidity compensation use the same Magnus transformations
+  // Compensated dew point calculation using compensated measurements and the Magnus formula: https://en.wikipedia.org/wiki/Dew_point#Calculating_the_dew_point
+  //magnusGammaTRH = (float)log(humidity_compensated / 100.0F) + 17.625F * temperature_compensated / (243.04F + temperature_compensated);
+  //dew_point_compensated = 243.04F * magnusGammaTRH / (17.625F - magnusGammaTRH); // Celsius
+
+  dew_point_dirty = false;
+}
+#endif
+
+// Calculate the compensated humidity from the raw humidity and the temperature offset
+template <class IAQPolicy>
+void IAQCoreT<IAQPolicy>::calculateCompensatedHumidity(void)
+{
+  // Compensate humidity based on the temperature offset
+  float svpMeasured = magnusSaturationVaporPressure(input_temperature); // Saturation vapor pressure at the measured temperature
+  float avpMeasured = input_humidity / 100.0F * svpMeasured; //The actual vapor pressure represents the real amount of water vapor in the air. It can be calculated from the measured relative humidity and the saturation vapor pressure at the measured temperature.
+  float svpCompensated = magnusSaturationVaporPressure(temperature_compensated); // Saturation vapor pressure at the compensated temperature
+  humidity_compensated = avpMeasured / svpCompensated * 100.0F; // Relative humidity at the compensated temperature
+  humidity_compensated_dirty = false;
+
+#if SE_BME680_ENABLE_DERIVED_METRICS
+  // Extended metrics share the vapor pressure computed above
+  if (derived_metrics != SE_BME680_METRIC_NONE) calculateDerivedMetrics(avpMeasured);
+#endif
+}
+
+#if SE_BME680_ENABLE_DERIVED_METRICS
+// Calculate the selected extended metrics from the compensated temperature and humidity
+template <class IAQPolicy>
+void IAQCoreT<IAQPolicy>::calculateDerivedMetrics(float vaporPressure)
+{
+  float t = temperature_compensated;
+  float p = input_pressure / 100.0F; // Station pressure in hPa
+
+  // Water vapor density from the ideal gas law, with 216.679 = 100 Pa/hPa * 1000 g/kg / 461.52 J/(kg*K)
+  if (derived_metrics & SE_BME680_METRIC_ABSOLUTE_HUMIDITY) absolute_humidity = 216.679F * vaporPressure / (t + 273.15F);
+
+  // Heat index using the NOAA algorithm, which is defined in Fahrenheit: https://www.wpc.ncep.noaa.gov/html/heatindex_equation.shtml
+  if (derived_metrics & SE_BME680_METRIC_HEAT_INDEX)
+  {
+    float tf = t * 1.8F + 32.0F;
+    float rh = humidity_compensated;
+    float hi = 0.5F * (tf + 61.0F + (tf - 68.0F) * 1.2F + rh * 0.094F); // Steadman's simple formula, valid below 80°F
+    if ((hi + tf) / 2.0F >= 80.0F)
+    {
+      // Rothfusz regression with the NOAA adjustments for low and high humidity
+      hi = -42.379F + 2.04901523F * tf + 10.14333127F * rh - 0.22475541F * tf * rh - 0.00683783F * tf * tf - 0.05481717F * rh * rh
+         + 0.00122874F * tf * tf * rh + 0.00085282F * tf * rh * rh - 0.00000199F * tf * tf * rh * rh;
+      if (rh < 13.0F && tf >= 80.0F && tf <= 112.0F) hi -= (13.0F - rh) / 4.0F * sqrt((17.0F - fabs(tf - 95.0F)) / 17.0F);
+      else if (rh > 85.0F && tf >= 80.0F && tf <= 87.0F) hi += (rh - 85.0F) / 10.0F * (87.0F - tf) / 5.0F;
+    }
+    heat_index = (hi - 32.0F) / 1.8F; // Celsius
+  }
+
+  // Humidex from the vapor pressure, which is what the dew point in the Environment Canada formula stands for
+  if (derived_metrics & SE_BME680_METRIC_HUMIDEX) humidex = t + 0.5555F * (vaporPressure - 10.0F);
+
+  // Mixing ratio, with 621.97 = 1000 g/kg * ratio of the molar masses of water and dry air
+  if (derived_metrics & SE_BME680_METRIC_MIXING_RATIO) mixing_ratio = 621.97F * vaporPressure / (p - vaporPressure);
+
+  // Barometric formula, matching Adafruit_BME680::readAltitude()
+  if (derived_metrics & SE_BME680_METRIC_SEA_LEVEL_PRESSURE) pressure_sea_level = p * sea_level_pressure_factor;
+  if (derived_metrics & SE_BME680_METRIC_ALTITUDE) altitude = 44330.0F * (1.0F - pow(p / altitude_reference_pressure, 0.1903F));
+}
+
+// Set the altitude of the sensor for the sea-level pressure
+template <class IAQPolicy>
+bool IAQCoreT<IAQPolicy>::setStationAltitude(float meters)
+{
+  if (!(meters >= -500.0F && meters <= 9000.0F)) return false;
+  sea_level_pressure_factor = pow(1.0F - meters / 44330.0F, -5.255F); // Constant for a fixed station, so it is only computed here
+  return true;
+}
+
+// Set the sea-level reference pressure for the altitude
+template <class IAQPolicy>
+bool IAQCoreT<IAQPolicy>::setAltitudeReferencePressure(float hPa)
+{
+  if (!(hPa >= 300.0F && hPa <= 1100.0F)) return false;
+  altitude_reference_pressure = hPa;
+  return true;
+}
+#endif
+
+// Enable or disable lazy evaluation of derived outputs
+template <class IAQPolicy>
+void IAQCoreT<IAQPolicy>::setLazyEvaluation(bool enabled)
+{
+  // Bring the properties up to date before switching modes
+#if SE_BME680_ENABLE_DEW_POINT
+  getDewPoint();
+#endif
+  getCompensatedHumidity();
+#if SE_BME680_ENABLE_IAQ
+  getIAQ();
+#endif
+  lazy_enabled = enabled;
+}
+
+#if SE_BME680_ENABLE_DEW_POINT
+// Get the dew point of the last reading, computing it first if needed
+template <class IAQPolicy>
+float IAQCoreT<IAQPolicy>::getDewPoint(void)
+{
+  if (dew_point_dirty) calculateDewPoint();
+  return dew_point;
+}
+#endif
+
+// Get the compensated humidity of the last reading, computing it first if needed
+template <class IAQPolicy>
+float IAQCoreT<IAQPolicy>::getCompensatedHumidity(void)
+{
+  if (humidity_compensated_dirty) calculateCompensatedHumidity();
+  return humidity_compensated;
+}
+
+#if SE_BME680_ENABLE_IAQ
+// Get the IAQ of the last reading, computing the score first if needed
+template <class IAQPolicy>
+float IAQCoreT<IAQPolicy>::getIAQ(void)
+{
+  if (IAQ_dirty)
+  {
+    IAQ = Scoring::score(iaq_pending_compensated_gas_r, iaq_pending_gas_ceiling);
+    IAQ_dirty = false;
+  }
+  return IAQ;
+}
+#endif
+
+// Process one reading
+template <class IAQPolicy>
+void IAQCoreT<IAQPolicy>::process(unsigned long timestamp, float temperature, float humidity, float pressure, uint32_t gas_resistance)
+{
+  // Keep the raw inputs for the derived outputs
+  input_temperature = temperature;
+  input_humidity = humidity;
+#if SE_BME680_ENABLE_DERIVED_METRICS
+  input_pressure = pressure;
+#else
+  (void)pressure;
+#endif
+
+  // Compensate temperature based on the temperature offset
+  temperature_compensated = temperature + temperature_offset; // Celsius
+
+  if (lazy_enabled)
+  {
+    // Defer the derived outputs until they are accessed
+#if SE_BME680_ENABLE_DEW_POINT
+    dew_point_dirty = true;
+#endif
+    humidity_compensated_dirty = true;
+  }
+  else
+  {
+#if SE_BME680_ENABLE_DEW_POINT
+    calculateDewPoint();
+#endif
+    calculateCompensatedHumidity();
+  }
+
+#if SE_BME680_ENABLE_IAQ
+  // Calculate IAQ
+  calculateIAQ(timestamp, gas_resistance);
+#else
+  (void)timestamp;
+  (void)gas_resistance;
+#endif
+}
+
+#if SE_BME680_ENABLE_IAQ
+// Set gas resistance compensation slope factor
+template <class IAQPolicy>
+bool IAQCoreT<IAQPolicy>::setGasCompensationSlopeFactor(double slopeFactor)
+{
+  return gas_compensation.setSlopeFactor(slopeFactor);
+}
+
+// Set the lower and upper "high" gas resistance limits for gas calibration
+template <class IAQPolicy>
+bool IAQCoreT<IAQPolicy>::setUpperGasResistanceLimits(uint32_t minLimit, uint32_t maxLimit)
+{
+  if (minLimit >= 30000 && maxLimit <= 2000000 && minLimit <= maxLimit)
+  {
+    // Set the limits only if they are within a reasonable range
+    gas_resistance_limit_min = minLimit;
+    gas_resistance_limit_max = maxLimit;
+    return true; // Limits successfully set
+  }
+  return false; // Invalid limits
+}
+
+// Set minimum timings for gas calibration stages
+template <class IAQPolicy>
+bool IAQCoreT<IAQPolicy>::setGasCalibrationTimings(int initTime, int burninTime, int decayTime)
+{
+  return gas_ceiling_estimator.setTimings(initTime, burninTime, decayTime);
+}
+#endif
+
+#endif
@@ -0,0 +1,112 @@
+/**
+ * @file  IAQPolicies.h
+ * @brief Compile-time strategies for the IAQ calculation: the humidity compensation model, the gas ceiling estimator and the scoring curve.
+ *        A policy bundle selects one of each and is passed as the template parameter of SE_BME680T. Only the selected strategies are compiled,
+ *        and calls are resolved statically (no virtual dispatch).
+ *
+ *        Custom bundles usually inherit from DefaultIAQPolicy and replace only what they need:
+ *          struct LinearPolicy : DefaultIAQPolicy { typedef LinearIAQScore Scoring; };
+ *          SE_BME680T<LinearPolicy> bme;
+ *
+ *        Strategy requirements:
+ *          Compensation: double factor(float temperature, float humidity) const, returning the multiplier applied to gas resistance
+ *          Ceiling:      void reset(unsigned long now), void rejectReading(unsigned long ms),
+ *                        void update(unsigned long now, uint32_t gas_resistance, double compensated_gas_r, double compensated_gas_r_min),
+ *                        double getCeiling() const, int getStage() const, float getRange() const, int getAccuracy() const
+ *          Scoring:      static float score(double compensated_gas_r, double gas_ceiling), returning IAQ in the range 0-100%
+ */
+
+#ifndef __IAQ_POLICIES_H__
+#define __IAQ_POLICIES_H__
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#else
+#include <math.h>
+#include <stdint.h>
+#endif
+#include <StagedGasCeiling.h>
+#include <MagnusTable.h>
+
+// Humidity compensation using a linear compensation of the logarithmic gas resistance by the absolute humidity
+// References and credits:
+//   https://github.com/thstielow/raspi-bme680-iaq
+//   https://forums.pimoroni.com/t/bme680-observed-gas-ohms-readings/6608/18
+class MagnusGasCompensation
+{
+  private:
+    // Slope of the linear compensation of the logatihmic gas resistance by the present humidity (see references)
+    double iaq_slope_factor = 0.03;
+
+  public:
+    /*!
+    *  @brief Set gas resistance compensation slope factor
+    *  @param slopeFactor
+    *         The slope factor for the linear compensation of the logarithmic gas resistance by the present humidity (default 0.03)
+    */
+    bool setSlopeFactor(double slopeFactor)
+    {
+//TODO: Validate slope factor range, e.g., 0.01 to 0.1
+      iaq_slope_factor = slopeFactor;
+      return true; // Slope factor successfully set
+    }
+
+    /*!
+    *  @brief Calculate the humidity compensation factor for gas resistance
+    *  @param temperature
+    *         Temperature in degrees Celsius
+    *  @param humidity
+    *         Relative humidity in percent
+    *  @return Multiplier to apply to gas resistance
+    */
+    double factor(float temperature, float humidity) const
+    {
+      // Calculate the saturation water vapor density of air at the current temperature (°C) in kg/m^3, which is equal to a relative humidity of 100% at the current temperature
+      double svd = magnusSaturationVaporDensity(temperature);
+
+      // Calculate absolute humidity using the saturation water density
+      double hum_abs = humidity * 10 * svd;
+
+      // Compensate exponential impact of humidity on resistance
+      return exp(iaq_slope_factor * hum_abs); // Exponential factor based on humidity
+    }
+};
+
+// No humidity compensation, gas resistance is used as-is
+class NoGasCompensation
+{
+  public:
+    double factor(float, float) const { return 1.0; }
+};
+
+// Relative air quality on a scale of 0-100% using a quadratic ratio for steeper scaling at higher air qualities
+class QuadraticIAQScore
+{
+  public:
+    static float score(double compensated_gas_r, double gas_ceiling)
+    {
+      double quality = pow(compensated_gas_r / gas_ceiling, 2) * 100.0;
+      return (float)quality < 100.0F ? (float)quality : 100.0F; // Ensure IAQ does not exceed 100%
+    }
+};
+
+// Relative air quality on a scale of 0-100% using a linear ratio
+class LinearIAQScore
+{
+  public:
+    static float score(double compensated_gas_r, double gas_ceiling)
+    {
+      double quality = compensated_gas_r / gas_ceiling * 100.0;
+      return (float)quality < 100.0F ? (float)quality : 100.0F; // Ensure IAQ does not exceed 100%
+    }
+};
+
+// Default strategies, matching the original behavior of the library
+struct DefaultIAQPolicy
+{
+  typedef MagnusGasCompensation Compensation;
+  typedef StagedGasCeiling Ceiling;
+  typedef QuadraticIAQScore Scoring;
+};
+
+#endif
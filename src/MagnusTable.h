@@ -0,0 +1,133 @@
+/**
+ * @file  MagnusTable.h
+ * @brief Saturation vapor pressure from the Magnus formula, either through libm exp() or through a lookup table generated at compile time.
+ *        The table covers the operating range of the BME680 (-40°C to 85°C) in MAGNUS_TABLE_STEP increments and is stored in flash (PROGMEM).
+ *        Lookups interpolate linearly between neighboring entries, and temperatures outside the table fall back to libm.
+ *
+ *        Error bound of the interpolated lookup relative to the exact formula, for the default 0.05°C step:
+ *          Interpolation: h^2/8 * max|f''/f| = 0.05^2/8 * 0.0098 = 3.1e-6 (worst case at -40°C, about 1.0e-6 at 25°C)
+ *          Storage: float entries add at most 6e-8 (half an ulp)
+ *          Total: below 3.5 ppm relative, which is far below the ±3% RH accuracy of the sensor.
+ *        The error grows with the square of the step, e.g. 0.5°C steps give about 310 ppm with a tenth of the flash.
+ *
+ *        Flash cost is 4 bytes per entry: 2501 entries (about 10 KB) at the default step.
+ *        Enable with SE_BME680_ENABLE_MAGNUS_TABLE (see SE_BME680_config.h); examples/magnus_table_benchmark compares both paths on the target board.
+ * @link  https://en.wikipedia.org/wiki/Clausius%E2%80%93Clapeyron_relation#Meteorology_and_climatology
+ */
+
+#ifndef __MAGNUS_TABLE_H__
+#define __MAGNUS_TABLE_H__
+
+#include <math.h>
+#include <SE_BME680_config.h>
+
+#if defined(__AVR__)
+#include <avr/pgmspace.h>
+#define MAGNUS_TABLE_READ(p) pgm_read_float(p)
+#else
+#ifndef PROGMEM
+#define PROGMEM
+#endif
+#define MAGNUS_TABLE_READ(p) (*(p))
+#endif
+
+// Table range and step in degrees Celsius
+#define MAGNUS_TABLE_MIN -40.0
+#define MAGNUS_TABLE_MAX 85.0
+#ifndef MAGNUS_TABLE_STEP
+#define MAGNUS_TABLE_STEP 0.05
+#endif
+#define MAGNUS_TABLE_SIZE ((int)((MAGNUS_TABLE_MAX - MAGNUS_TABLE_MIN) / MAGNUS_TABLE_STEP + 1.5))
+
+// Compile-time exp() using the Taylor series, with exp(x) = 1 / exp(-x) for negative arguments to avoid cancellation
+constexpr double magnusExpSeries(double x, double term, int n)
+{
+  return n > 40 ? 0.0 : term + magnusExpSeries(x, term * x / (double)(n + 1), n + 1);
+}
+constexpr double magnusExp(double x)
+{
+  return x < 0.0 ? 1.0 / magnusExpSeries(-x, 1.0, 0) : magnusExpSeries(x, 1.0, 0);
+}
+
+// Saturation vapor pressure in hPa at the given temperature in degrees Celsius, evaluated at compile time
+constexpr double magnusSvpConstexpr(double t)
+{
+  return 6.112 * magnusExp(17.625 * t / (243.04 + t));
+}
+
+// Index sequence built by halving, so the template depth stays logarithmic in the table size
+template <int... I> struct MagnusSequence { typedef MagnusSequence type; };
+template <class A, class B> struct MagnusConcat;
+template <int... A, int... B> struct MagnusConcat<MagnusSequence<A...>, MagnusSequence<B...>> : MagnusSequence<A..., (int)sizeof...(A) + B...> {};
+template <int N> struct MagnusMakeSequence : MagnusConcat<typename MagnusMakeSequence<N / 2>::type, typename MagnusMakeSequence<N - N / 2>::type> {};
+template <> struct MagnusMakeSequence<0> : MagnusSequence<> {};
+template <> struct MagnusMakeSequence<1> : MagnusSequence<0> {};
+
+// Table of saturation vapor pressures, one entry per step. Only instantiated (and stored in flash) when it is used.
+template <class S> struct MagnusTableData;
+template <int... I> struct MagnusTableData<MagnusSequence<I...>>
+{
+  static const float svp[sizeof...(I)];
+};
+template <int... I> const float MagnusTableData<MagnusSequence<I...>>::svp[sizeof...(I)] PROGMEM = { (float)magnusSvpConstexpr(MAGNUS_TABLE_MIN + (double)I * MAGNUS_TABLE_STEP)... };
+typedef MagnusTableData<MagnusMakeSequence<MAGNUS_TABLE_SIZE>::type> MagnusTable;
+
+/*!
+*  @brief  Saturation vapor pressure using the Magnus formula and libm
+*  @param  t
+*          Temperature in degrees Celsius
+*  @return Saturation vapor pressure in hPa
+*/
+inline float magnusSaturationVaporPressureExact(float t)
+{
+  return 6.112F * exp(17.625F * t / (243.04F + t));
+}
+
+/*!
+*  @brief  Saturation vapor pressure using the compile-time table with linear interpolation, falling back to libm outside the table range
+*  @param  t
+*          Temperature in degrees Celsius
+*  @return Saturation vapor pressure in hPa
+*/
+inline float magnusSaturationVaporPressureTable(float t)
+{
+  float x = (t - (float)MAGNUS_TABLE_MIN) * (float)(1.0 / MAGNUS_TABLE_STEP);
+  if (!(x >= 0.0F) || x >= (float)(MAGNUS_TABLE_SIZE - 1)) return magnusSaturationVaporPressureExact(t); // Out of range or NaN
+  int i = (int)x;
+  float f = x - (float)i;
+  float a = MAGNUS_TABLE_READ(&MagnusTable::svp[i]);
+  float b = MAGNUS_TABLE_READ(&MagnusTable::svp[i + 1]);
+  return a + f * (b - a);
+}
+
+/*!
+*  @brief  Saturation vapor pressure, using the table when SE_BME680_ENABLE_MAGNUS_TABLE is set and libm otherwise
+*  @param  t
+*          Temperature in degrees Celsius
+*  @return Saturation vapor pressure in hPa
+*/
+inline float magnusSaturationVaporPressure(float t)
+{
+#if SE_BME680_ENABLE_MAGNUS_TABLE
+  return magnusSaturationVaporPressureTable(t);
+#else
+  return magnusSaturationVaporPressureExact(t);
+#endif
+}
+
+/*!
+*  @brief  Saturation water vapor density of air, which is equal to a relative humidity of 100% at the given temperature
+*  @param  t
+*          Temperature in degrees Celsius
+*  @return Saturation vapor density in kg/m^3
+*/
+inline double magnusSaturationVaporDensity(float t)
+{
+#if SE_BME680_ENABLE_MAGNUS_TABLE
+  return ((double)magnusSaturationVaporPressureTable(t) * 100.0) / (461.52 * (t + 273.15)); // Same table, one division for the ideal gas law
+#else
+  return (6.112 * 100.0 * exp(17.625 * t / (243.04 + t))) / (461.52 * (t + 273.15));
+#endif
+}
+
+#endif
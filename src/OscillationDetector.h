@@ -0,0 +1,146 @@
+/**
+ * @file  OscillationDetector.h
+ * @brief Helper class to detect the dominant oscillation period in sensor readings, such as the cycling of air conditioners and heaters.
+ *        A bank of leaky (exponentially forgetting) DFT resonators is tuned to log-spaced candidate periods. Each sample costs one complex
+ *        multiply-add per resonator and no sample history is stored. Two channels (e.g. temperature and humidity) can be tracked at once;
+ *        their spectra are normalized by their variance and added, so either channel can reveal the cycle.
+ * @link  https://en.wikipedia.org/wiki/Goertzel_algorithm
+ */
+
+#ifndef __OSCILLATION_DETECTOR_H__
+#define __OSCILLATION_DETECTOR_H__
+
+#include <math.h>
+
+// Maximum number of candidate periods (resonators)
+#ifndef OSCILLATION_BINS_MAX
+#define OSCILLATION_BINS_MAX 16
+#endif
+
+class OscillationDetector
+{
+  private:
+    int bins = 0; // Number of resonators in use
+    float binPeriod[OSCILLATION_BINS_MAX]; // Candidate period of each resonator, in samples
+    float rotRe[OSCILLATION_BINS_MAX], rotIm[OSCILLATION_BINS_MAX]; // Per-sample rotation of each resonator, including the decay factor
+    float binGain[OSCILLATION_BINS_MAX]; // Power normalization of each resonator, so that white noise scores the same in every bin
+    float re[2][OSCILLATION_BINS_MAX], im[2][OSCILLATION_BINS_MAX]; // Resonator state per channel
+    float mean[2], variance[2]; // Slow baseline and variance per channel, used to detrend and normalize the input
+    float baselineAlpha = 0.0F; // Smoothing factor for the baseline and variance
+    float ratio = 1.0F; // Ratio between neighboring candidate periods
+    unsigned long samples = 0; // Number of samples tracked since the last reset
+    unsigned long warmup = 0; // Number of samples required before a period is reported
+
+  public:
+    float period = 0.0F; // Detected dominant period in samples, or zero if no period has been detected yet
+    float confidence = 0.0F; // Share of the total spectral power at the detected period (0-1)
+
+    /*!
+    *  @brief  Set the range of candidate periods and clear the detector
+    *  @param  minPeriod
+    *          Shortest period to detect, in samples (at least 4)
+    *  @param  maxPeriod
+    *          Longest period to detect, in samples
+    *  @param  binCount
+    *          Number of log-spaced candidate periods (2 to OSCILLATION_BINS_MAX)
+    *  @return True if the parameters were set successfully, false if they are invalid
+    */
+    bool configure(int minPeriod, int maxPeriod, int binCount = OSCILLATION_BINS_MAX)
+    {
+      if (minPeriod < 4 || maxPeriod <= minPeriod || binCount < 2 || binCount > OSCILLATION_BINS_MAX) return false;
+      bins = binCount;
+      ratio = (float)pow((double)maxPeriod / (double)minPeriod, 1.0 / (double)(bins - 1));
+
+      // Each resonator forgets with a time constant of a couple of its own periods (constant Q), so its bandwidth covers the gap to its neighbors
+      for (int k = 0; k < bins; k++)
+      {
+        double p = (double)minPeriod * pow((double)ratio, (double)k);
+        double w = 6.283185307179586 / p; // Angular frequency in radians per sample
+        double leak = 1.0 / (2.0 * p);
+        binPeriod[k] = (float)p;
+        rotRe[k] = (float)((1.0 - leak) * cos(w));
+        rotIm[k] = (float)((1.0 - leak) * sin(w));
+        binGain[k] = (float)leak;
+      }
+      baselineAlpha = 1.0F / (float)maxPeriod;
+      warmup = 2UL * (unsigned long)maxPeriod;
+      reset();
+      return true;
+    }
+
+    // Clear the detector state while keeping the configuration
+    void reset(void)
+    {
+      for (int c = 0; c < 2; c++)
+      {
+        for (int k = 0; k < bins; k++) re[c][k] = im[c][k] = 0.0F;
+        mean[c] = variance[c] = 0.0F;
+      }
+      samples = 0;
+      period = 0.0F;
+      confidence = 0.0F;
+    }
+
+    // Track a new pair of data points and update the detected period and confidence
+    void track(float primary, float secondary = 0.0F)
+    {
+      if (bins == 0) return; // Not configured
+
+      float x[2] = { primary, secondary };
+      float power[OSCILLATION_BINS_MAX];
+      for (int k = 0; k < bins; k++) power[k] = 0.0F;
+
+      for (int c = 0; c < 2; c++)
+      {
+        // Detrend against a slow baseline, seeded with the first data point
+        if (samples == 0) mean[c] = x[c];
+        float d = x[c] - mean[c];
+        mean[c] += baselineAlpha * d;
+        variance[c] += baselineAlpha * (d * d - variance[c]);
+
+        // Rotate, decay and excite each resonator
+        for (int k = 0; k < bins; k++)
+        {
+          float r = re[c][k] * rotRe[k] - im[c][k] * rotIm[k] + d;
+          im[c][k] = re[c][k] * rotIm[k] + im[c][k] * rotRe[k];
+          re[c][k] = r;
+        }
+
+        // Add the normalized spectrum of this channel
+        if (variance[c] > 0.0F)
+        {
+          for (int k = 0; k < bins; k++) power[k] += (re[c][k] * re[c][k] + im[c][k] * im[c][k]) * binGain[k] / variance[c];
+        }
+      }
+      samples++;
+      if (samples < warmup) return; // Not enough history yet
+
+      // Find the strongest resonator and its share of the total power
+      int peak = 0;
+      float total = 0.0F;
+      for (int k = 0; k < bins; k++)
+      {
+        total += power[k];
+        if (power[k] > power[peak]) peak = k;
+      }
+      if (total <= 0.0F)
+      {
+        period = 0.0F;
+        confidence = 0.0F;
+        return;
+      }
+      confidence = power[peak] / total;
+
+      // Refine the period between neighboring resonators with a parabolic fit on the log-period axis
+      float offset = 0.0F;
+      if (peak > 0 && peak < bins - 1)
+      {
+        float a = power[peak - 1], b = power[peak], c = power[peak + 1];
+        float denominator = a - 2.0F * b + c;
+        if (denominator < 0.0F) offset = 0.5F * (a - c) / denominator;
+      }
+      period = binPeriod[peak] * (float)pow((double)ratio, (double)offset);
+    }
+};
+
+#endif
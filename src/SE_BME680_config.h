@@ -0,0 +1,82 @@
+/**
+ * @file  SE_BME680_config.h
+ * @brief Compile-time feature switches for SE_BME680. Define any of these as 0 before including SE_BME680.h (or as build flags) to remove the subsystem
+ *        from both the code and the object layout. A build with everything disabled only adds temperature and humidity compensation to the Adafruit library.
+ *
+ *          #define SE_BME680_ENABLE_IAQ 0       // IAQ calculation, gas calibration, spike filter and smoothing
+ *          #define SE_BME680_ENABLE_SMOOTHING 0 // Donchian and exponential smoothing, and automatic smoothing periods
+ *          #define SE_BME680_ENABLE_DEW_POINT 0 // Dew point calculation
+ *          #define SE_BME680_ENABLE_DERIVED_METRICS 0 // Absolute humidity, heat index, humidex, mixing ratio, sea-level pressure and altitude
+ *          #include <SE_BME680.h>
+ *
+ *        Optional speed/size trade-offs, disabled by default:
+ *
+ *          #define SE_BME680_ENABLE_MAGNUS_TABLE 1 // Saturation vapor pressure from a compile-time table in flash instead of exp(), see MagnusTable.h
+ *          #define SE_BME680_SMOOTHING_POOL_SIZE 600 // Donchian smoothing storage inside the object (in floats, 3 per period) instead of the heap
+ *          #define SE_BME680_QUANTIZED_SMOOTHING 1   // Donchian smoothing history in 16 bits per value instead of 32, see DonchianAverage.h
+ *          #define SE_BME680_DONCHIAN_BLOCK_SIZE 64  // Donchian smoothing history as per-block min/max summaries for very long periods, see DonchianBlockAverage.h
+ *          #define SE_BME680_PACKED_LAYOUT 1         // Flags, calibration stage and IAQ accuracy as bit fields, for processes holding many objects
+ */
+
+#ifndef __SE_BME680_CONFIG_H__
+#define __SE_BME680_CONFIG_H__
+
+// IAQ calculation, including gas calibration, the gas spike filter and smoothing
+#ifndef SE_BME680_ENABLE_IAQ
+#define SE_BME680_ENABLE_IAQ 1
+#endif
+
+// Smoothing of the IAQ inputs, which is only available together with the IAQ calculation
+#ifndef SE_BME680_ENABLE_SMOOTHING
+#define SE_BME680_ENABLE_SMOOTHING SE_BME680_ENABLE_IAQ
+#endif
+#if SE_BME680_ENABLE_SMOOTHING && !SE_BME680_ENABLE_IAQ
+#undef SE_BME680_ENABLE_SMOOTHING
+#define SE_BME680_ENABLE_SMOOTHING 0
+#endif
+
+// Dew point calculation
+#ifndef SE_BME680_ENABLE_DEW_POINT
+#define SE_BME680_ENABLE_DEW_POINT 1
+#endif
+
+// Extended derived metrics, computed together with the compensated humidity when selected with setDerivedMetrics()
+#ifndef SE_BME680_ENABLE_DERIVED_METRICS
+#define SE_BME680_ENABLE_DERIVED_METRICS 1
+#endif
+
+// Saturation vapor pressure lookup table, trading about 10 KB of flash for the exp() calls in humidity compensation and the IAQ calculation
+#ifndef SE_BME680_ENABLE_MAGNUS_TABLE
+#define SE_BME680_ENABLE_MAGNUS_TABLE 0
+#endif
+
+// Donchian smoothing storage embedded in each object, in floats (three per smoothing period). Zero uses the heap unless a buffer is supplied with setSmoothingBuffer().
+#ifndef SE_BME680_SMOOTHING_POOL_SIZE
+#define SE_BME680_SMOOTHING_POOL_SIZE 0
+#endif
+
+// Donchian smoothing history stored as 16-bit fixed point (linear for temperature and humidity, logarithmic for gas resistance), halving its memory
+#ifndef SE_BME680_QUANTIZED_SMOOTHING
+#define SE_BME680_QUANTIZED_SMOOTHING 0
+#endif
+
+// Donchian smoothing history kept as min/max summaries of blocks of this many samples instead of every sample. Zero keeps every sample.
+#ifndef SE_BME680_DONCHIAN_BLOCK_SIZE
+#define SE_BME680_DONCHIAN_BLOCK_SIZE 0
+#endif
+
+// Packed object layout: flags, the calibration stage and the IAQ accuracy are stored as bit fields instead of whole bools and ints, at the cost of
+// a few masking instructions per access. Hot per-reading state is grouped together in both layouts; this only changes how tightly it is packed.
+#ifndef SE_BME680_PACKED_LAYOUT
+#define SE_BME680_PACKED_LAYOUT 0
+#endif
+
+// Declares a member as a bit field of the given width in the packed layout, or as a whole member with the given initial value otherwise.
+// Bit fields cannot have default member initializers before C++20, so their owner also assigns the initial value in its constructor.
+#if SE_BME680_PACKED_LAYOUT
+#define SE_BME680_BITS(bits, init) : bits
+#else
+#define SE_BME680_BITS(bits, init) = init
+#endif
+
+#endif
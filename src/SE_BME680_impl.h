@@ -0,0 +1,118 @@
+/**
+ * @file  SE_BME680_impl.h
+ * @brief Implementation of the SE_BME680T class template, included by SE_BME680.h
+ */
+
+#ifndef __SE_BME680_IMPL_H__
+#define __SE_BME680_IMPL_H__
+
+// SE_BME680 IAC constructor
+template <class IAQPolicy>
+SE_BME680T<IAQPolicy>::SE_BME680T(TwoWire *wire) : Adafruit_BME680(wire)
+{
+#if SE_BME680_ENABLE_IAQ
+  Core::resetCalibration(millis()); // Start the calibration stage timings now
+#endif
+}
+
+// SE_BME680 SPI constructor
+template <class IAQPolicy>
+SE_BME680T<IAQPolicy>::SE_BME680T(int8_t cspin, SPIClass *spi) : Adafruit_BME680(cspin, spi)
+{
+#if SE_BME680_ENABLE_IAQ
+  Core::resetCalibration(millis()); // Start the calibration stage timings now
+#endif
+}
+
+// SE_BME680 software SPI constructor
+template <class IAQPolicy>
+SE_BME680T<IAQPolicy>::SE_BME680T(int8_t cspin, int8_t mosipin, int8_t misopin, int8_t sckpin) : Adafruit_BME680(cspin, mosipin, misopin, sckpin)
+{
+#if SE_BME680_ENABLE_IAQ
+  Core::resetCalibration(millis()); // Start the calibration stage timings now
+#endif
+}
+
+// Begin a reading from the BME680 sensor
+template <class IAQPolicy>
+uint32_t SE_BME680T<IAQPolicy>::beginReading(void)
+{
+  // Proxy to base class
+  return Adafruit_BME680::beginReading();
+}
+
+// Perform a reading from the BME680 sensor
+template <class IAQPolicy>
+bool SE_BME680T<IAQPolicy>::performReading(void)
+{
+  return endReading();
+}
+
+// End a reading from the BME680 sensor
+template <class IAQPolicy>
+bool SE_BME680T<IAQPolicy>::endReading(void)
+{
+  // Proxy to base class
+  if (!Adafruit_BME680::endReading()) return false;
+
+  // Process the reading
+  this->process(millis(), temperature, humidity, (float)pressure, gas_resistance);
+
+  // Return true to indicate a successful reading
+  return true;
+}
+
+// Perform a multi-step heater scan
+template <class IAQPolicy>
+bool SE_BME680T<IAQPolicy>::performHeaterScan(const uint16_t* heaterTemperatures, int steps, uint16_t heaterDuration, float* resistances, uint16_t restoreTemperature, uint16_t restoreDuration)
+{
+  bool success = steps > 0;
+  for (int i = 0; i < steps && success; i++)
+  {
+    // Measure with the base class only, so the scan does not feed the IAQ calculation
+    success = setGasHeater(heaterTemperatures[i], heaterDuration) && Adafruit_BME680::performReading();
+    if (success) resistances[i] = (float)gas_resistance;
+  }
+
+  // Restore the regular heater profile
+  setGasHeater(restoreTemperature, restoreDuration);
+  return success;
+}
+
+#if SE_BME680_ENABLE_DEW_POINT
+// Perform a reading and return the dew point
+template <class IAQPolicy>
+float SE_BME680T<IAQPolicy>::readDewPoint(void)
+{
+  performReading();
+  return this->getDewPoint();
+}
+#endif
+
+// Perform a reading and return the compensated temperature
+template <class IAQPolicy>
+float SE_BME680T<IAQPolicy>::readCompensatedTemperature(void)
+{
+  performReading();
+  return this->temperature_compensated;
+}
+
+// Perform a reading and return the compensated humidity
+template <class IAQPolicy>
+float SE_BME680T<IAQPolicy>::readCompensatedHumidity(void)
+{
+  performReading();
+  return this->getCompensatedHumidity();
+}
+
+#if SE_BME680_ENABLE_IAQ
+// Perform a reading and return the Indoor Air Quality (IAQ)
+template <class IAQPolicy>
+float SE_BME680T<IAQPolicy>::readIAQ(void)
+{
+  performReading();
+  return this->getIAQ();
+}
+#endif
+
+#endif
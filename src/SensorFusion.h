@@ -0,0 +1,310 @@
+/**
+ * @file  SensorFusion.h
+ * @brief Fusion of several redundant SE_BME680 sensors in one room into a single voted reading. Conversions are started on all sensors together, so the
+ *        readings of one cycle are aligned to within one conversion time. Compensated temperature, compensated humidity and IAQ are fused with a median
+ *        or a trimmed mean, which a single faulty sensor cannot pull away.
+ *
+ *        Each sensor has a health score derived from how far it has recently been from the fused reading, measured in multiples of a per-channel tolerance
+ *        and tracked with an exponential moving average. A sensor that stays more than one tolerance away (drift, contamination, a failed heater) is excluded
+ *        from fusion until it comes back within half a tolerance. Failed readings, including readings that are not finite, count as four tolerances of
+ *        deviation (the cap for wild readings), so a sensor that keeps failing is excluded within a few cycles. Non-finite values never reach the median.
+ *
+ *        Cost per cycle is O(k) for k sensors (expected, using quickselect), with all state in fixed arrays and no dynamic allocation.
+ *        Host builds (e.g. checks with simulated sensors) can fuse any type with the reading interface of SE_BME680, without a default sensor type.
+ */
+
+#ifndef __SENSOR_FUSION_H__
+#define __SENSOR_FUSION_H__
+
+#ifdef ARDUINO
+#include <SE_BME680.h>
+#else
+#include <IAQCore.h>
+#endif
+
+// Maximum number of sensors that can be fused
+#ifndef SENSOR_FUSION_MAX
+#define SENSOR_FUSION_MAX 8
+#endif
+static_assert(SENSOR_FUSION_MAX <= 32, "SENSOR_FUSION_MAX is limited to 32 by the 32-bit mask of valid readings");
+
+/*!
+*  @brief  Fusion of redundant sensors into one room-level reading
+*  @tparam Sensor
+*          Sensor type, any SE_BME680T instantiation (on the host, any type with its beginReading(), endReading() and getter methods)
+*/
+#ifdef ARDUINO
+template <class Sensor = SE_BME680>
+#else
+template <class Sensor>
+#endif
+class SensorFusionT
+{
+  private:
+    Sensor* sensors[SENSOR_FUSION_MAX]; // Fused sensors, owned by the caller
+    int sensorCount = 0; // Number of fused sensors
+    float deviation[SENSOR_FUSION_MAX]; // Moving average of the deviation from the fused reading, in tolerances
+    bool excluded[SENSOR_FUSION_MAX]; // Whether the sensor is currently excluded from fusion
+    int trim = 0; // Number of lowest and highest values dropped for the trimmed mean, or zero for the median
+    float healthAlpha = 0.05F; // Smoothing factor for the deviation average, 2 / (periods + 1)
+
+    // Tolerances per channel, i.e. the deviation from the fused reading at which a sensor is considered faulty
+    float temperatureTolerance = 1.0F; // Celsius
+    float humidityTolerance = 5.0F; // RH %
+#if SE_BME680_ENABLE_IAQ
+    float iaqTolerance = 25.0F; // IAQ %
+#endif
+
+    // Rearrange values[first..last] so that values[k] holds the value it would have after sorting, with smaller values before it and larger ones after it.
+    // Expected O(n) (Hoare's quickselect).
+    static void select(float* values, int first, int last, int k)
+    {
+      while (first < last)
+      {
+        float pivot = values[(first + last) / 2];
+        int i = first, j = last;
+        while (i <= j)
+        {
+          while (values[i] < pivot) i++;
+          while (values[j] > pivot) j--;
+          if (i <= j)
+          {
+            float swap = values[i];
+            values[i++] = values[j];
+            values[j--] = swap;
+          }
+        }
+        if (k <= j) last = j;
+        else if (k >= i) first = i;
+        else return;
+      }
+    }
+
+    // Fuse n values with the median or the trimmed mean. The values are reordered.
+    float combine(float* values, int n) const
+    {
+      if (trim == 0)
+      {
+        // Median, averaging the two middle values for an even count
+        int m = n / 2;
+        select(values, 0, n - 1, m);
+        if (n % 2) return values[m];
+        select(values, 0, m - 1, m - 1); // Largest value of the lower half
+        return (values[m - 1] + values[m]) / 2.0F;
+      }
+
+      // Trimmed mean: move the t lowest values to the front and the t highest values to the back, then average the rest
+      int t = trim;
+      if (2 * t >= n) t = (n - 1) / 2; // Keep at least one value (two for an even count)
+      select(values, 0, n - 1, t);
+      select(values, t, n - 1, n - 1 - t);
+      float sum = 0.0F;
+      for (int i = t; i < n - t; i++) sum += values[i];
+      return sum / (float)(n - 2 * t);
+    }
+
+  public:
+    float temperature_compensated = NAN; // Fused compensated temperature (Celsius)
+    float humidity_compensated = NAN; // Fused compensated humidity (RH %)
+#if SE_BME680_ENABLE_IAQ
+    float IAQ = NAN; // Fused IAQ (0-100%), from sensors with an IAQ accuracy above zero
+    int IAQ_accuracy = 0; // Lowest IAQ accuracy among the fused sensors, or 0 if no sensor has a usable IAQ yet
+#endif
+    int contributors = 0; // Number of sensors that contributed to the last fused reading
+
+    SensorFusionT()
+    {
+      for (int i = 0; i < SENSOR_FUSION_MAX; i++)
+      {
+        sensors[i] = nullptr;
+        deviation[i] = 0.0F;
+        excluded[i] = false;
+      }
+    }
+
+    /*!
+    *  @brief  Add a sensor to the fusion. The sensor must already be initialized with begin() and must outlive the fusion.
+    *  @param  sensor
+    *          Sensor to add
+    *  @return Index of the sensor, or -1 if SENSOR_FUSION_MAX sensors were already added
+    */
+    int addSensor(Sensor* sensor)
+    {
+      if (sensor == nullptr || sensorCount >= SENSOR_FUSION_MAX) return -1;
+      sensors[sensorCount] = sensor;
+      deviation[sensorCount] = 0.0F;
+      excluded[sensorCount] = false;
+      return sensorCount++;
+    }
+
+    /*!
+    *  @brief  Select the fusion method
+    *  @param  trimCount
+    *          Number of lowest and highest values to drop before averaging, or zero for the median (default).
+    *          The trim is reduced automatically when too few sensors are available.
+    */
+    void setTrimmedMean(int trimCount) { trim = trimCount > 0 ? trimCount : 0; }
+
+    /*!
+    *  @brief  Set the tolerances used for the health scores. A sensor that deviates from the fused reading by more than a tolerance on average is excluded.
+    *  @param  temperature
+    *          Temperature tolerance in degrees Celsius (default 1)
+    *  @param  humidity
+    *          Humidity tolerance in RH % (default 5)
+    *  @param  iaq
+    *          IAQ tolerance in IAQ % (default 25). Ignored when the IAQ subsystem is disabled.
+    *  @return True if the tolerances were set successfully, false if any of them is not positive
+    */
+    bool setTolerances(float temperature, float humidity, float iaq = 25.0F)
+    {
+      if (!(temperature > 0.0F && humidity > 0.0F && iaq > 0.0F)) return false;
+      temperatureTolerance = temperature;
+      humidityTolerance = humidity;
+#if SE_BME680_ENABLE_IAQ
+      iaqTolerance = iaq;
+#endif
+      return true;
+    }
+
+    /*!
+    *  @brief  Set how many cycles the health scores average over
+    *  @param  periods
+    *          Time constant in cycles (at least 2, default 39). Longer periods ride out short disturbances but exclude drifting sensors later.
+    *  @return True if the periods were set successfully, false if they are invalid
+    */
+    bool setHealthPeriods(int periods)
+    {
+      if (periods < 2) return false;
+      healthAlpha = 2.0F / (float)(periods + 1);
+      return true;
+    }
+
+    /*!
+    *  @brief  Perform a reading on all sensors and fuse the results. All conversions are started before any of them is collected,
+    *          so the readings are taken at the same time instead of one after another.
+    *  @return True if at least one sensor contributed to the fused reading
+    */
+    bool performReading()
+    {
+      for (int i = 0; i < sensorCount; i++) sensors[i]->beginReading();
+      uint32_t valid = 0;
+      for (int i = 0; i < sensorCount; i++)
+      {
+        if (sensors[i]->endReading()) valid |= (uint32_t)1 << i;
+      }
+      return fuse(valid);
+    }
+
+    /*!
+    *  @brief  Fuse the last readings of the sensors, for sketches that read the sensors themselves
+    *  @param  validMask
+    *          Bit i is set if sensor i produced a valid reading in this cycle
+    *  @return True if at least one sensor contributed to the fused reading
+    */
+    bool fuse(uint32_t validMask)
+    {
+      float t[SENSOR_FUSION_MAX], h[SENSOR_FUSION_MAX];
+      int n = 0;
+#if SE_BME680_ENABLE_IAQ
+      float q[SENSOR_FUSION_MAX];
+      int nq = 0;
+      int accuracy = 4;
+#endif
+
+      // Readings that are not finite (e.g. NaN from a failed compensation) cannot be ordered by the median, so they count as failed readings
+      for (int i = 0; i < sensorCount; i++)
+      {
+        if (!(validMask >> i & 1)) continue;
+        bool usable = isfinite(sensors[i]->getCompensatedTemperature()) && isfinite(sensors[i]->getCompensatedHumidity());
+#if SE_BME680_ENABLE_IAQ
+        if (sensors[i]->getIAQAccuracy() > 0 && !isfinite(sensors[i]->getIAQ())) usable = false;
+#endif
+        if (!usable) validMask &= ~((uint32_t)1 << i);
+      }
+
+      // Collect the readings of valid sensors that are not excluded. If every valid sensor is excluded, use them all rather than report nothing.
+      bool useExcluded = true;
+      for (int i = 0; i < sensorCount; i++)
+      {
+        if ((validMask >> i & 1) && !excluded[i]) useExcluded = false;
+      }
+      for (int i = 0; i < sensorCount; i++)
+      {
+        if (!(validMask >> i & 1) || (excluded[i] && !useExcluded)) continue;
+        t[n] = sensors[i]->getCompensatedTemperature();
+        h[n] = sensors[i]->getCompensatedHumidity();
+        n++;
+#if SE_BME680_ENABLE_IAQ
+        if (sensors[i]->getIAQAccuracy() > 0)
+        {
+          q[nq++] = sensors[i]->getIAQ();
+          if (sensors[i]->getIAQAccuracy() < accuracy) accuracy = sensors[i]->getIAQAccuracy();
+        }
+#endif
+      }
+      contributors = n;
+      if (n == 0) return false;
+
+      temperature_compensated = combine(t, n);
+      humidity_compensated = combine(h, n);
+#if SE_BME680_ENABLE_IAQ
+      IAQ = nq > 0 ? combine(q, nq) : NAN;
+      IAQ_accuracy = nq > 0 ? accuracy : 0;
+#endif
+
+      // Update the health of every sensor against the fused reading, including excluded sensors so they can recover
+      for (int i = 0; i < sensorCount; i++)
+      {
+        float d = 4.0F; // A failed reading counts as the largest deviation, so a sensor that keeps failing is excluded
+        if (validMask >> i & 1)
+        {
+          d = fabs(sensors[i]->getCompensatedTemperature() - temperature_compensated) / temperatureTolerance;
+          float dh = fabs(sensors[i]->getCompensatedHumidity() - humidity_compensated) / humidityTolerance;
+          if (dh > d) d = dh;
+#if SE_BME680_ENABLE_IAQ
+          if (nq > 1 && sensors[i]->getIAQAccuracy() > 0)
+          {
+            float dq = fabs(sensors[i]->getIAQ() - IAQ) / iaqTolerance;
+            if (dq > d) d = dq;
+          }
+#endif
+          if (!(d <= 4.0F)) d = 4.0F; // Limit the effect of a single wild reading on the average
+        }
+        deviation[i] += healthAlpha * (d - deviation[i]);
+
+        // Exclusion with hysteresis
+        if (!excluded[i] && deviation[i] > 1.0F) excluded[i] = true;
+        else if (excluded[i] && deviation[i] < 0.5F) excluded[i] = false;
+      }
+      return true;
+    }
+
+    /*!
+    *  @brief Get the number of sensors added to the fusion
+    *  @return Number of sensors
+    */
+    int getSensorCount(void) const { return sensorCount; }
+
+    /*!
+    *  @brief Get the health score of a sensor
+    *  @param index
+    *         Sensor index returned by addSensor()
+    *  @return Health from 0 to 1, where 1 means the sensor agrees with the fused reading, 0.5 means it is one tolerance away on average and lower is worse
+    */
+    float getHealth(int index) const { return (index >= 0 && index < sensorCount) ? 1.0F / (1.0F + deviation[index]) : 0.0F; }
+
+    /*!
+    *  @brief Check whether a sensor is currently excluded from fusion
+    *  @param index
+    *         Sensor index returned by addSensor()
+    *  @return True if the sensor is excluded
+    */
+    bool isExcluded(int index) const { return (index >= 0 && index < sensorCount) ? excluded[index] : true; }
+};
+
+#ifdef ARDUINO
+// Fusion of default SE_BME680 sensors
+typedef SensorFusionT<> SensorFusion;
+#endif
+
+#endif
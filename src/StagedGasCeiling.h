@@ -0,0 +1,400 @@
+/**
+ * @file  StagedGasCeiling.h
+ * @brief Default gas ceiling estimator for the IAQ calculation. Tracks the average highest compensated gas resistance through three calibration stages
+ *        (initialization, burn-in and normal operation) and estimates the accuracy of the resulting IAQ.
+ *
+ *        The calibration data is stored through a storage codec, and the gas ceiling is always accumulated in double:
+ *          CalibrationDoubleStorage: 8 bytes per data point (4 on AVR, where double is float), the original behavior
+ *          CalibrationFloatStorage:  4 bytes per data point, relative error at most 6e-8 (half a float ulp)
+ *          CalibrationLogStorage:    2 bytes per data point, 16-bit logarithm from 1 ohm to 1G ohms, relative error at most 1.6e-4 (4 significant digits)
+ *        All codecs are monotonic, so the scans compare stored values directly. The log codec keeps a running sum instead of decoding every data point.
+ */
+
+#ifndef __STAGED_GAS_CEILING_H__
+#define __STAGED_GAS_CEILING_H__
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#else
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+#endif
+#include <SE_BME680_config.h>
+
+#define  GAS_CALIBRATION_DATA_POINTS 100
+
+// Full precision calibration data
+class CalibrationDoubleStorage
+{
+  public:
+    typedef double Sample;
+    static const bool cheapDecode = true; // Whether decoding is cheap enough to sum the whole array on every update
+    static Sample encode(double x) { return x; }
+    static double decode(Sample s) { return s; }
+};
+
+// Single precision calibration data
+class CalibrationFloatStorage
+{
+  public:
+    typedef float Sample;
+    static const bool cheapDecode = true;
+    static Sample encode(double x) { return (float)x; }
+    static double decode(Sample s) { return s; }
+};
+
+// 16-bit logarithmic calibration data from 1 ohm to 1G ohms. Code 0 marks an empty entry.
+class CalibrationLogStorage
+{
+  public:
+    typedef uint16_t Sample;
+    static const bool cheapDecode = false;
+    static Sample encode(double x)
+    {
+      if (!(x > 0.0)) return 0; // Empty, or NaN
+      double c = log(x) * (65534.0 / 20.723266) + 1.5; // ln(1e9) = 20.723266, codes 1-65535
+      if (c < 1.0) return 1;
+      if (c >= 65535.0) return 65535;
+      return (Sample)c;
+    }
+    static double decode(Sample s) { return s ? exp((double)(s - 1) * (20.723266 / 65534.0)) : 0.0; }
+};
+
+/*!
+*  @brief  Staged gas ceiling estimator
+*  @tparam CalibrationStorage
+*          Storage codec for the calibration data: CalibrationDoubleStorage, CalibrationFloatStorage or CalibrationLogStorage
+*/
+template <class CalibrationStorage = CalibrationDoubleStorage>
+class StagedGasCeilingT
+{
+  private:
+    typedef typename CalibrationStorage::Sample Sample;
+
+    // Members are ordered cold to hot, so that the per-reading state at the end sits next to the hot state of the owning SE_BME680 object
+
+    // Array of compensated gas readings used to calculate gas_ceiling
+    Sample gas_calibration_data[GAS_CALIBRATION_DATA_POINTS];
+
+    // Running sum of the decoded calibration data, used instead of a full sum when decoding is expensive
+    double gas_calibration_sum = 0;
+
+    // Stage 0: Minimum initialization time in milliseconds (30 seconds). The gas resistance will not be stable yet, but ceiling tracking can start and a low accuracy IAQ can be calculated. Resistance values prior to this time are very unstable.
+    int gas_calibration_init_time = 30*1000;
+
+    // Stage 1: Minimum burn-in time in milliseconds (5 minutes). After this time, the gas resistance is expected to be moderately stable and a more accurate IAQ can be calculated.
+    int gas_calibration_burnin_time = 5*60*1000;
+
+    // Stage 2: Time in milliseconds (30 minutes) after which the gas calibration data decays and the gas ceiling needs to be recalculated. This is to account for sensor drift and changes in the environment.
+    int gas_calibration_decay_time = 30*60*1000;
+
+    // Used to track gas resistance during the initialization stage. When gas resistance stops dropping after startup, then initialization is complete and the burn-in stage starts.
+    uint32_t gas_stage_0_last_low = 0;
+
+    // The average highest compensated gas reading, derived from values stord in gas_calibration_data[], used as the threshold for a "good" air quality reading
+    double gas_ceiling = 0;
+
+    // Timer for gas calibration stages, used to track sensor stabilization
+    unsigned long gas_calibration_timer = 0;
+
+    // Range of compensated gas resistance values used for gas calibration, calculated as a percentage of the maximum value in gas_calibration_data[]
+    float gas_calibration_range = 1.00F; // Default to 100% (lowest accuracy, zero is 100% of zero)
+
+    // Sensor uptime measured in decay intervals, used to estimate IAQ accuracy based on how long the sensor has been running in the current environment
+    int32_t sensor_uptime = 0;
+
+    // Number of higher lows seen so far during the initialization stage (0-3)
+    int gas_stage_0_low_count SE_BME680_BITS(3, 0);
+
+    // Current stage of gas calibration: 0 = initialization, 1 = burn-in, 2 = normal operation
+    int gas_calibration_stage SE_BME680_BITS(3, 0);
+
+    // Index for the next entry in the gas calibration data array, which wraps around to zero when the end of the array is reached
+    int gas_calibration_data_index SE_BME680_BITS(8, 0); // 0-99
+
+    /*!
+    *  @brief  Update gas calibration data with a new compensated gas reading, calculate the arithmetic mean of the gas calibration data, and update the gas ceiling value
+    *  @param  compensated_gas
+    *          The compensated gas resistance value to be added to the gas calibration data
+    *  @param  replaceSmallest
+    *          If true, replace the smallest value in the gas calibration data array with the new compensated gas reading; otherwise, just add the new reading to the array
+    */
+    void updateGasCalibration(double compensated_gas, bool replaceSmallest = false)
+    {
+      // Update the array of compensated gas readings with the new compensated gas reading
+      Sample compensated_sample = CalibrationStorage::encode(compensated_gas);
+      if (replaceSmallest && gas_calibration_data[GAS_CALIBRATION_DATA_POINTS - 1] > 0) // If (replaceSmallest is true AND the array is already full of values collected during burn-in)...
+      {
+        // Replace the smallest value in the gas calibration data array with the new compensated gas reading
+        Sample smallest_value = gas_calibration_data[0];
+        int smallest_index = 0;
+        for (int i = 1; i < GAS_CALIBRATION_DATA_POINTS; i++)
+        {
+          if (gas_calibration_data[i] < smallest_value)
+          {
+            smallest_value = gas_calibration_data[i];
+            smallest_index = i;
+          }
+        }
+        if (compensated_sample > smallest_value)
+        {
+          // Replace the smallest value with the new compensated gas reading
+          gas_calibration_data[smallest_index] = compensated_sample;
+          if (!CalibrationStorage::cheapDecode) gas_calibration_sum += CalibrationStorage::decode(compensated_sample) - CalibrationStorage::decode(smallest_value);
+        }
+      }
+      else
+      {
+        // Add the compensated gas reading to the gas calibration data array
+        if (!CalibrationStorage::cheapDecode) gas_calibration_sum += CalibrationStorage::decode(compensated_sample) - CalibrationStorage::decode(gas_calibration_data[gas_calibration_data_index]);
+        gas_calibration_data[gas_calibration_data_index] = compensated_sample;
+        gas_calibration_data_index++;
+        if (gas_calibration_data_index >= GAS_CALIBRATION_DATA_POINTS)
+        {
+          // Wrap around to the beginning of the array
+          gas_calibration_data_index = 0;
+        }
+      }
+
+      // Calculate the arithmetic mean and min/max range of the calibration array (which may not be completely populated yet)
+      Sample dataPoint, calMin = 0, calMax = 0;
+      double sum = 0, mean = 0;
+      int count = 0;
+      for (int i = 0; i < GAS_CALIBRATION_DATA_POINTS; i++)
+      {
+        dataPoint = gas_calibration_data[i];
+        if (dataPoint > 0) // Skip zero entries (which happen before the array is fully populated)
+        {
+          if (CalibrationStorage::cheapDecode) sum += CalibrationStorage::decode(dataPoint);
+          if (calMin == 0) calMin = dataPoint; else if (dataPoint < calMin) calMin = dataPoint;
+          if (calMax == 0) calMax = dataPoint; else if (dataPoint > calMax) calMax = dataPoint;
+          count++;
+        }
+      }
+      if (!CalibrationStorage::cheapDecode) sum = gas_calibration_sum; // Running sum instead of decoding every entry
+      if (count)
+      {
+        if (calMax > 0)
+        {
+          // Calculate the min/max range as a percentage of the maximum value
+          double calMaxDecoded = CalibrationStorage::decode(calMax);
+          gas_calibration_range = (float)((calMaxDecoded - CalibrationStorage::decode(calMin)) / calMaxDecoded);
+        }
+        mean = sum / (double)count;
+        if (!isnan(mean))
+        {
+          // Update the gas ceiling value with the new mean
+          gas_ceiling = mean;
+        }
+      }
+    }
+
+  public:
+
+    // Constructor, starting in the initialization stage
+    StagedGasCeilingT() { reset(0); }
+
+    /*!
+    *  @brief  Reset all calibration state and restart the initialization stage
+    *  @param  now
+    *          Current time in milliseconds
+    */
+    void reset(unsigned long now)
+    {
+      memset(gas_calibration_data, 0, sizeof(gas_calibration_data)); // Initialize gas tracking array to zeros
+      gas_calibration_sum = 0;
+      gas_calibration_stage = 0; // Default to initialization stage
+      gas_calibration_data_index = 0; // Default to the first entry in the gas calibration data array
+      gas_calibration_range = 1.0F; // No data yet, so set range to 100% (lowest accuracy, zero is 100% of zero)
+      gas_ceiling = 0; // Default to zero gas ceiling
+      sensor_uptime = 0; // Reset uptime tracking
+      gas_stage_0_last_low = 0; // Reset gas stage 0 initialization tracking
+      gas_stage_0_low_count = 0;
+      gas_calibration_timer = now; // Reset the gas calibration timer
+    }
+
+    /*!
+    *  @brief  Resume the calibration state of another estimator, e.g. one saved before a restart, keeping the timings of this one
+    *  @param  saved
+    *          Estimator to copy the calibration data, stage, timer and uptime from
+    */
+    void resume(const StagedGasCeilingT& saved)
+    {
+      memcpy(gas_calibration_data, saved.gas_calibration_data, sizeof(gas_calibration_data));
+      gas_calibration_sum = saved.gas_calibration_sum;
+      gas_stage_0_last_low = saved.gas_stage_0_last_low;
+      gas_ceiling = saved.gas_ceiling;
+      gas_calibration_timer = saved.gas_calibration_timer;
+      gas_calibration_range = saved.gas_calibration_range;
+      sensor_uptime = saved.sensor_uptime;
+      gas_stage_0_low_count = saved.gas_stage_0_low_count;
+      gas_calibration_stage = saved.gas_calibration_stage;
+      gas_calibration_data_index = saved.gas_calibration_data_index;
+    }
+
+    /*!
+    *  @brief  Account for a gas reading that was rejected before reaching the estimator
+    *  @param  ms
+    *          Time in milliseconds to add to the calibration timer while the sensor is still stabilizing
+    */
+    void rejectReading(unsigned long ms = 1000)
+    {
+      if (gas_calibration_stage < 2)
+      {
+        // Add time to the calibration timer to allow more time to stabilize
+        gas_calibration_timer += ms;
+      }
+    }
+
+    /*!
+    *  @brief  Advance the calibration stages and the gas ceiling with a new reading
+    *  @param  now
+    *          Current time in milliseconds
+    *  @param  gas_resistance
+    *          Raw gas resistance in ohms, used to detect stabilization during the initialization stage
+    *  @param  compensated_gas_r
+    *          Humidity compensated gas resistance
+    *  @param  compensated_gas_r_min
+    *          Humidity compensated minimum gas resistance limit, important if the sensor is started in a low air quality environment
+    */
+    void update(unsigned long now, uint32_t gas_resistance, double compensated_gas_r, double compensated_gas_r_min)
+    {
+      switch (gas_calibration_stage)
+      {
+        // Initialization stage. Gas readings are simply ignored until the sensor stabilizes, which is when gas resistance values stop falling and start posting higher lows. A minimum initialization time is also enforced.
+        case 0:
+          if (now - gas_calibration_timer >= (unsigned long)gas_calibration_init_time)
+          {
+            if (gas_stage_0_last_low == 0)
+            {
+              // Initialization
+              gas_stage_0_last_low = gas_resistance;
+              gas_stage_0_low_count = 0; // No higher lows yet
+            }
+            else if (gas_resistance < gas_stage_0_last_low)
+            {
+              // If the gas resistance is lower than the last low, then update the last low and reset the higher lows count
+              gas_stage_0_last_low = gas_resistance;
+              gas_stage_0_low_count = 0; // Reset higher lows count
+            }
+            else if (gas_resistance > gas_stage_0_last_low)
+            {
+              // If the gas resistance is higher than the last low, increment the higher lows count. Stabilization is becoming apparent.
+              gas_stage_0_low_count++;
+
+              // If gas resistance has posted a few higher lows, then assume the sensor has stabilized and move to the burn-in stage
+              if (gas_stage_0_low_count >= 3)
+              {
+                // Initialization stage is complete, so move to the burn-in stage
+                gas_calibration_timer = now; // Reset the calibration timer to start the burn-in stage
+                gas_calibration_stage = 1; // Move to burn-in stage
+              }
+            }
+          }
+          break;
+
+        // Burn-in stage. The sensor is expected to be stabilizing and gas ceiling values can now be collected. Burn-in stage will last until the calbiration array is fully populated AND the minimum burn-in time has elapsed.
+        case 1:
+          if (now - gas_calibration_timer < (unsigned long)gas_calibration_burnin_time || gas_calibration_data[GAS_CALIBRATION_DATA_POINTS - 1] == 0)
+          {
+            // Fill the calibration array first, and then continue to update the array by replacing the smallest value. This effectively collects the highest witnessed compensated gas resistance values during burn-in.
+            updateGasCalibration(compensated_gas_r > compensated_gas_r_min ? compensated_gas_r : compensated_gas_r_min, true); // Limit calibration data to the compensated minimum gas resistance limit
+          }
+          else
+          {
+            // Burn-in stage is complete, so move to the normal operation stage
+            gas_calibration_timer = now; // Reset the calibration timer to start normal operation stage
+            gas_calibration_stage = 2; // Move to normal operation stage
+          }
+          break;
+
+        // Normal operation stage. The sensor is expected to be stable and any new "high" gas ceiling values can be collected. Decay intervals will force updates to the gas calibration data to account for sensor drift and changes in the environment over time.
+        case 2:
+          if (compensated_gas_r > compensated_gas_r_min)
+          {
+            if (compensated_gas_r > gas_ceiling)
+            {
+              // Integrate new higher gas readings into the gas calibration data array to establish a better gas ceiling for "good" air quality
+              updateGasCalibration(compensated_gas_r, true); // Adapt ongoing average gas ceiling based on new high readings
+            }
+            else if (now - gas_calibration_timer >= (unsigned long)gas_calibration_decay_time)
+            {
+              // Rotate out older values from the gas calibration data array to account for sensor drift and changes in the environment
+              updateGasCalibration(compensated_gas_r, false); // Adapt ongoing average gas ceiling based on decay timings
+              gas_calibration_timer = now; // Reset the calibration timer to start a new decay period
+              sensor_uptime++; // Increment sensor uptime to track how long the sensor has been running in the current environment
+            }
+          }
+          break;
+      }
+    }
+
+    /*!
+    *  @brief  Get the average highest compensated gas reading used as the threshold for a "good" air quality reading
+    *  @return Gas ceiling, or zero if no calibration data has been collected yet
+    */
+    double getCeiling(void) const { return gas_ceiling; }
+
+    /*!
+    *  @brief  Get the current calibration stage
+    *  @return 0 = initialization, 1 = burn-in, 2 = normal operation
+    */
+    int getStage(void) const { return gas_calibration_stage; }
+
+    /*!
+    *  @brief  Get the min/max range of the calibration data as a fraction of the maximum value
+    *  @return Range from 0.0 (best) to 1.0 (worst)
+    */
+    float getRange(void) const { return gas_calibration_range; }
+
+    /*!
+    *  @brief  Estimate IAQ calculation accuracy based on gas calibration timing stage, calibration data range and sensor uptime
+    *  @return 0 = unreliable, 1 = low accuracy, 2 = moderate accuracy, 3 = high accuracy, 4 = very high accuracy
+    */
+    int getAccuracy(void) const
+    {
+      int accuracy = 0;
+      switch (gas_calibration_stage)
+      {
+        case 0: // Initialization stage
+          accuracy = 0; // Unreliable
+          break;
+        case 1: // Burn-in stage
+          accuracy = 1; // Low accuracy
+          break;
+        case 2: // Normal operation stage
+          accuracy = 1; // Low accuracy by default
+          if (gas_calibration_range < 0.080F) accuracy = 2; // Moderate accuracy
+          if (gas_calibration_range < 0.035F && sensor_uptime >= 2)   accuracy = 3; // High accuracy, requires at least several decay intervals of sensor uptime in the current environment
+          if (gas_calibration_range < 0.020F && sensor_uptime >= 100) accuracy = 4; // Very high accuracy, which typically requires days of sensor uptime in the current environment
+          break;
+      }
+      return accuracy;
+    }
+
+    /*!
+    *  @brief  Set minimum timings for the calibration stages
+    *  @return True if the timings were set successfully, false if the timings are invalid
+    */
+    bool setTimings(int initTime, int burninTime, int decayTime)
+    {
+      if (initTime > 0 && burninTime >= initTime && decayTime >= burninTime)
+      {
+        // Ensure that the timings are valid
+        if (initTime < 1000) initTime = 1000; // Minimum 1 second for initialization
+        if (burninTime < initTime + 1000) burninTime = initTime + 1000; // Minimum 1 second after initialization for burn-in
+        if (decayTime < burninTime + 60000) decayTime = burninTime + 60000; // Minimum 1 minute after burn-in for decay
+        gas_calibration_init_time = initTime;
+        gas_calibration_burnin_time = burninTime;
+        gas_calibration_decay_time = decayTime;
+        return true; // Timings successfully set
+      }
+      return false; // Invalid timings
+    }
+};
+
+// Staged gas ceiling estimator with full precision calibration data
+typedef StagedGasCeilingT<> StagedGasCeiling;
+
+#endif